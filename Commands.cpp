@@ -12,7 +12,20 @@
 #include <type_traits>
 #include <stdio.h>
 #include <fcntl.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
 #include "Commands.h"
+#include "Crc32c.h"
 
 using namespace std;
 
@@ -38,10 +51,22 @@ const std::string WHITESPACE = " \n\r\t\f\v";
 #endif
 
 #define DIGITS "1234567890"
+//characters that make bash do more than split words and remove quotes when they aren't quoted, so a line containing
+//them can't be exec'd directly
+#define SHELL_SPECIAL_CHARS "*?[]{}~$`<>|&;()!#"
 const std::string COMMAND_UNPRINT = "cmd not to print";
 const job_id_t UNINITIALIZED_JOB_ID=-1;
 const job_id_t FG_JOB_ID = 0;
 const int NO_OPTIONS = 0;
+//largest single request handed to copy_file_range/sendfile, and buffer size of the read/write fallback
+const size_t COPY_CHUNK_SIZE = 1 << 30;
+const size_t COPY_BUFFER_SIZE = 1 << 20;
+//ranges cp -j splits a file into, each copied (and verified) by one worker at a time
+const off_t COPY_RANGE_SIZE = 64 * 1024 * 1024;
+//what a range check returns when the checksums of the two files differ, unlike any errno
+const int CHECKSUM_MISMATCH = -1;
+//output a builtin pipe stage collects before writing it to the pipe - the default capacity of a pipe
+const size_t PIPE_STAGE_BUFFER_SIZE = 64 * 1024;
 
 /// USE THIS WHEN SENDING ORDERS TO PROCESSES THAT SHOULD AFFECT PROCESS'S CHILDREN!
 /// \param pcb process control block representing process to send signal to
@@ -50,6 +75,10 @@ const int NO_OPTIONS = 0;
 /// \return true if succeeded, false if failed to send signal
 
 bool sendSignal(const ProcessControlBlock& pcb, signal_t sig_num, errno_t* errCodeReturned) {
+    if (pcb.isQueued()) { //no process group yet - killpg(0) would signal smash itself
+        if (errCodeReturned) *errCodeReturned = ESRCH;
+        return false;
+    }
     int res1 = killpg(pcb.getProcessGroupId(), sig_num);
     //cout << "res1 = " << res1 << ", error code" << *errCodeReturned << endl;
     bool result = (res1 >= 0);
@@ -57,11 +86,19 @@ bool sendSignal(const ProcessControlBlock& pcb, signal_t sig_num, errno_t* errCo
     return result;
 }
 
+/// \return exit status bash would report for the wait status of a foreground process
+int _exitStatus(int waitStatus) {
+    if (WIFEXITED(waitStatus)) return WEXITSTATUS(waitStatus);
+    if (WIFSIGNALED(waitStatus)) return 128 + WTERMSIG(waitStatus);
+    if (WIFSTOPPED(waitStatus)) return 128 + WSTOPSIG(waitStatus);
+    return 0;
+}
+
 unsigned short indicator(bool condition) {
     return condition ? 1 : 0;
 }
 
-std::unique_ptr<Command> SmallShell::containedBuild(const string cmd_line){
+std::unique_ptr<Command> SmallShell::containedBuild(std::string_view cmd_line){
     unique_ptr<Command> result;
     try {
         return std::move(this->CreateCommand(cmd_line));
@@ -79,10 +116,11 @@ std::unique_ptr<Command> SmallShell::containedBuild(const string cmd_line){
     }
     return nullptr;
 }
-bool SmallShell::containedExecute(const unique_ptr<Command> &cmd) {
+bool SmallShell::containedExecute(const unique_ptr<Command> &cmd, bool inSon) {
     try {
         if (cmd) {
-            cmd->execute();
+            if (inSon) cmd->executeInSon();
+            else cmd->execute();
             return true;
         }
     }
@@ -100,36 +138,6 @@ bool SmallShell::containedExecute(const unique_ptr<Command> &cmd) {
     return false;
 }
 
-template<>
-ProcessControlBlock* Heap<ProcessControlBlock*>::getMax() {
-    if (empty()) throw SmashExceptions::NoStoppedJobsException();
-
-    ProcessControlBlock *result = this->front();
-    for (ProcessControlBlock *elem : *this) if (*elem > *result) result = elem;
-    return result;
-}
-
-template<class T>
-void Heap<T>::insert(T &newElement) {
-    std::vector<T>::push_back(newElement);
-    push_heap(this->begin(), this->end());
-}
-
-template<class T>
-bool Heap<T>::empty() {
-    return std::vector<T>::empty();
-}
-
-template<class T>
-void Heap<T>::erase(const T &target) {
-    std::vector<ProcessControlBlock *>::iterator position =
-            find(this->begin(), this->end(), target);
-    if (position != this->end()) std::vector<T>::erase(position);
-
-    make_heap(this->begin(), this->end());
-}
-
-
 ///strip spaces from beginning
 ///implemented for trim
 string _ltrim(const std::string &s) {
@@ -150,28 +158,121 @@ string _trim(const std::string &s) {
     return _rtrim(_ltrim(s));
 }
 
-int _parseCommandLine(string cmd_line, char **args) {
-    FUNC_ENTRY()
-    int i = 0;
-    std::istringstream iss(_trim(cmd_line).c_str());
-    for (std::string s; iss >> s;) {
-        args[i] = (char *) malloc(s.length() + 1);
-        memset(args[i], 0, s.length() + 1);
-        strcpy(args[i], s.c_str());
-        args[++i] = NULL;
+/// split a command line into words in a single pass, the way bash does: whitespace separates words, '...' keeps its
+/// contents as is, "..." keeps its contents except for a backslash escaping \ " $ or `, and a backslash outside
+/// quotes escapes any character. The line ends at its first '\0' (see _removeBackgroundSign), and a background sign
+/// at its end is not a word
+/// \param arena receives the words without their quotes, each terminated by '\0' so it can be handed to exec as is.
+/// It is sized once for the whole line, so the words never move
+/// \param words where to return the words to, pointing into arena
+/// \return true if the words are all bash would make of the line - no quotes are left open and no character that
+/// bash expands or interprets appears outside single quotes
+bool _tokenize(std::string_view cmd_line, std::pmr::string &arena, std::pmr::vector<std::string_view> &words) {
+    size_t lineLength = std::min(cmd_line.find('\0'), cmd_line.length());
+    const size_t lastCharacter = lineLength ? cmd_line.find_last_not_of(WHITESPACE, lineLength - 1) : string::npos;
+    if (lastCharacter != string::npos && cmd_line[lastCharacter] == '&') lineLength = lastCharacter;
+    //a word never grows longer than its text, and its terminator takes the place of the whitespace after it
+    arena.assign(lineLength + 1, '\0');
+    words.clear();
+
+    size_t length = 0, wordStart = 0;
+    bool inWord = false, literal = true;
+    char quote = '\0';
+    for (size_t i = 0; i < lineLength; ++i) {
+        const char c = cmd_line[i];
+        if (quote == '\'') {
+            if (c == '\'') quote = '\0';
+            else arena[length++] = c;
+        } else if (quote == '"') {
+            if (c == '$' || c == '`') literal = false;
+            if (c == '"') quote = '\0';
+            else if (c == '\\' && i + 1 < lineLength && strchr("\\\"$`", cmd_line[i + 1])) arena[length++] = cmd_line[++i];
+            else arena[length++] = c;
+        } else if (WHITESPACE.find(c) != string::npos) {
+            if (!inWord) continue;
+            words.emplace_back(&arena[wordStart], length - wordStart);
+            arena[length++] = '\0';
+            inWord = false;
+        } else {
+            if (!inWord) {
+                inWord = true;
+                wordStart = length;
+            }
+            if (strchr(SHELL_SPECIAL_CHARS, c)) literal = false;
+            if (c == '\'' || c == '"') quote = c;
+            else if (c == '\\' && i + 1 < lineLength) arena[length++] = cmd_line[++i];
+            else arena[length++] = c;
+        }
     }
-    return i;
-
-    FUNC_EXIT()
+    if (inWord) words.emplace_back(&arena[wordStart], length - wordStart);
+    return literal && quote == '\0';
+}
+
+/// find an operator character ('|' or '>') that smash acts on, skipping those that are quoted or escaped by the rules
+/// of _tokenize
+/// \param start where to look from, which must not be inside quotes
+/// \return position of the first unquoted operator character at or after start, or npos if there is none
+size_t _findUnquoted(std::string_view cmd_line, char operatorCharacter, size_t start = 0) {
+    const size_t lineLength = std::min(cmd_line.find('\0'), cmd_line.length());
+    char quote = '\0';
+    for (size_t i = start; i < lineLength; ++i) {
+        const char c = cmd_line[i];
+        if (quote == '\'') {
+            if (c == '\'') quote = '\0';
+        } else if (quote == '"') {
+            if (c == '"') quote = '\0';
+            else if (c == '\\' && i + 1 < lineLength && strchr("\\\"$`", cmd_line[i + 1])) ++i;
+        } else if (c == operatorCharacter) return i;
+        else if (c == '\'' || c == '"') quote = c;
+        else if (c == '\\') ++i;
+    }
+    return string::npos;
+}
+
+/// \param operatorPosition position of the unquoted '>' (or first '>' of ">>") of the redirection
+/// \return the file the redirection writes to, the first word after the operator
+string _redirectionTarget(std::string_view cmd_line, size_t operatorPosition) {
+    const size_t targetStart = operatorPosition + 1 + indicator(cmd_line.substr(operatorPosition + 1, 1) == ">");
+    std::pmr::string arena;
+    std::pmr::vector<std::string_view> words;
+    _tokenize(cmd_line.substr(targetStart), arena, words);
+    return words.empty() ? string() : string(words.front());
+}
+
+/// open target of an output redirection
+/// \return file descriptor of opened file
+int _openOutputFile(const string& fileName, bool append) {
+    int fd = open(fileName.c_str(), O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0666);
+    if (fd < 0) throw SmashExceptions::SyscallException("open");
+    return fd;
+}
+
+/// \param seconds duration in seconds, whole or with a fraction (e.g. 0.25), accurate to a millisecond
+/// \return duration in milliseconds
+uint64_t _secondsToMilliseconds(const string& seconds) {
+    const size_t point = seconds.find('.');
+    const string whole = seconds.substr(0, point);
+    const string fraction = (point == string::npos) ? "" : seconds.substr(point + 1);
+    if ((whole.empty() && fraction.empty()) || whole.length() > 9 ||
+        whole.find_first_not_of(DIGITS) != string::npos || fraction.find_first_not_of(DIGITS) != string::npos) {
+        throw std::invalid_argument("Bad duration");
+    }
+    uint64_t milliseconds = whole.empty() ? 0 : stoull(whole) * 1000;
+    //digits beyond milliseconds are dropped
+    for (size_t digit = 0, scale = 100; digit < 3 && digit < fraction.length(); ++digit, scale /= 10) {
+        milliseconds += (fraction[digit] - '0') * scale;
+    }
+    return milliseconds;
 }
 
-bool _isBackgroundComamnd(basic_string<char, char_traits<char>, allocator<char>> cmd_line) {
-    const string str(cmd_line);
-    return str[str.find_last_not_of(WHITESPACE)] == '&';
+bool _isBackgroundComamnd(std::string_view cmd_line) {
+    const size_t last = cmd_line.find_last_not_of(WHITESPACE);
+    return last != std::string_view::npos && cmd_line[last] == '&';
 }
 
-string _removeBackgroundSign(string cmd_line) {
-    const string str(cmd_line);
+string _removeBackgroundSign(std::string_view line) {
+    string cmd_line(line);
+    const string& str = cmd_line;
     // find last character other than spaces
     size_t idx = str.find_last_not_of(WHITESPACE);
     // if all characters are spaces then return
@@ -192,22 +293,32 @@ string _removeBackgroundSign(string cmd_line) {
 
 
 
+int SmallShell::interruptSignal = 0;
+
 SmallShell::SmallShell() : smashProcessGroup(getpgrp()), smashPid(getpid()), jobs(*this) {}
 
 /**
 * Creates and returns a pointer to Command class which matches the given command line (cmd_line)
 */
-std::unique_ptr<Command> SmallShell::CreateCommand(string cmd_line) {
-    string cmd_s = _trim(string(cmd_line));
-    string opcode = _trim(_removeBackgroundSign(cmd_s.substr(0, cmd_s.find_first_of(WHITESPACE))));
-
-    //Special commands
-    if ((cmd_s.find('|') != string::npos) && (("chprompt") != opcode))
-        return std::unique_ptr<Command>(new PipeCommand(cmd_line, this));
-    else if ((cmd_s.find('>') != string::npos) && (("chprompt") != opcode)) {
-
-        int operatorPosition = (cmd_line.find_first_of('>'));
-        RedirectionCommand::createEmptyFile(cmd_line); //this is in case command fails before file is created
+std::unique_ptr<Command> SmallShell::CreateCommand(std::string_view cmd_line) {
+    TraceScope trace(TRACE_PARSE);
+    //first word, without a background sign stuck to it
+    const size_t opcodeStart = std::min(cmd_line.find_first_not_of(WHITESPACE), cmd_line.length());
+    std::string_view opcode = std::string_view(cmd_line).substr(opcodeStart,
+            cmd_line.find_first_of(WHITESPACE, opcodeStart) - opcodeStart);
+    if (!opcode.empty() && opcode.back() == '&') opcode.remove_suffix(1);
+
+    //commands whose arguments may hold '|' and '>' of their own
+    const bool literalArguments = (("chprompt") == opcode) || (("parallel") == opcode) || (("after") == opcode);
+
+    //Special commands - only their unquoted operators count, so that quoted text may hold '|' and '>'
+    const size_t pipePosition = literalArguments ? string::npos : _findUnquoted(cmd_line, '|');
+    const size_t operatorPosition = (literalArguments || pipePosition != string::npos) ? string::npos :
+            _findUnquoted(cmd_line, '>');
+    if (pipePosition != string::npos) return std::unique_ptr<Command>(new PipeCommand(cmd_line, this));
+    else if (operatorPosition != string::npos) {
+        //this is in case command fails before file is created
+        RedirectionCommand::createEmptyFile(cmd_line, operatorPosition);
 
         return std::unique_ptr<Command>(new RedirectionCommand(cmd_line, operatorPosition, this));
     }
@@ -223,52 +334,36 @@ std::unique_ptr<Command> SmallShell::CreateCommand(string cmd_line) {
     else if (("kill") == opcode) return std::unique_ptr<Command>(new KillCommand(cmd_line, this));
     else if (("bg") == opcode) return std::unique_ptr<Command>(new BackgroundCommand(cmd_line, this));
     else if (("fg") == opcode) return std::unique_ptr<Command>(new ForegroundCommand(cmd_line, this));
+    else if (("hash") == opcode) return std::unique_ptr<Command>(new HashCommand(cmd_line, this));
+    else if (("launch") == opcode) return std::unique_ptr<Command>(new LaunchCommand(cmd_line, this));
+    else if (("allocs") == opcode) return std::unique_ptr<Command>(new AllocationsCommand(cmd_line, this));
+    else if (("parallel") == opcode) return std::unique_ptr<Command>(new ParallelCommand(cmd_line, this));
+    else if (("after") == opcode) return std::unique_ptr<Command>(new AfterCommand(cmd_line, this));
+    else if (("trace") == opcode) return std::unique_ptr<Command>(new TraceCommand(cmd_line, this));
+    else if (("history") == opcode) return std::unique_ptr<Command>(new HistoryCommand(cmd_line, this));
     else if (("quit") == opcode) return std::unique_ptr<Command>(new QuitCommand(cmd_line, this));
     else return std::unique_ptr<Command>(new ExternalCommand(cmd_line, this));
 }
 
-//ROI
-
-TimedProcessControlBlock *SmallShell::getLateProcess() //ROI
-{
-    jobs.removeFinishedJobs();
-    for (TimedProcessControlBlock& timed_pcb: jobs.timed_processes) {
-
-        if (difftime(time(nullptr), timed_pcb.getAbortTime()) == 0) {
-            pid_t pid = timed_pcb.getProcessId();
-            // in case of built-in command
-            if (pid == UNINITIALIZED_JOB_ID) return nullptr;
-
-            job_id_t jobId = timed_pcb.getJobId();
-            if (!jobs.getJobById(jobId)) {
-                //DEBUG_PRINT("job already killed by removeFinishedJobs");
-                return nullptr;
-            }
-            else {
-                return &timed_pcb;
-            }
-        }
-    }
-    return nullptr;
-}
-
-void SmallShell::RemoveLateProcesses() {
-    TimedProcessControlBlock targetPcb = *(jobs.timed_processes.begin());
-
-    if (!::sendSignal(targetPcb, SIGKILL)) {
-        //DEBUG_PRINT("Tried killing but failed");
-        return;
-    }
-
-    jobs.timed_processes.erase(jobs.timed_processes.begin());
-}
-
-void SmallShell::executeCommand(string cmd_line) {
-    containedExecute(containedBuild(cmd_line));
+void SmallShell::executeCommand(std::string_view cmd_line) {
+    const unsigned long heapAllocationsBefore = heapAllocationCount();
+    //foreground commands replace it with the status of their process
+    lastExitStatus = 0;
+    executingLine = cmd_line;
+    const uint64_t traceStart = Tracer::begin();
+    if (!containedExecute(containedBuild(cmd_line))) lastExitStatus = 1;
+    Tracer::end(TRACE_LINE, traceStart, cmd_line);
+    executingLine = std::string_view();
 
     //shouldn't be necessary (control should never reach here by non-smash functions, but just in case)
     bool isSmashProcess = (getpid()==smashPid);
     if (!isSmashProcess) exit(0); //only smash may continue operation, not processes that escaped via exception throw
+
+    lastLineHeapAllocations = heapAllocationCount() - heapAllocationsBefore;
+    lastLineArenaAllocations = lineArena.getLineAllocations();
+    lastLineArenaBytes = lineArena.getLineBytes();
+    //the commands of the line are gone by now
+    lineArena.reset();
 }
 
 const string &SmallShell::getSmashPrompt() const noexcept {
@@ -287,23 +382,6 @@ const string &SmallShell::getLastPwd() const {
     return lastPwd;
 }
 
-/// \param signum
-/// \param jobId
-/// \return success=true, failuer=false
-bool SmallShell::sendSignal(signal_t signum, job_id_t jobId) {
-    string killCmdText = string("kill -") + std::to_string(signum) + " " + std::to_string(jobId);
-    std::unique_ptr<KillCommand> killCmd = std::unique_ptr<KillCommand>(new KillCommand(killCmdText, this));
-    killCmd->verbose = false;
-    assert(killCmd);
-
-    try {
-        killCmd->execute();
-    } catch (SmashExceptions::SignalSendException e) {
-        return false;
-    }
-    return true;
-}
-
 const ProcessControlBlock *SmallShell::getForegroundProcess() const {
     return foregroundProcess;
 }
@@ -317,11 +395,81 @@ void SmallShell::setForegroundProcess(const ProcessControlBlock *foregroundProce
     SmallShell::foregroundProcess = foregroundProcess;
 }
 
+void SmallShell::revalidatePathCache() {
+    const char *pathVariable = getenv("PATH");
+    const string currentPath = pathVariable ? pathVariable : "";
+
+    //a stat per directory on every lookup - a command added to or removed from a directory changes its modification
+    //time, so a cached path is never used once it is stale
+    bool valid = (currentPath == cachedPathVariable);
+    if (valid) {
+        for (const auto &directory : pathDirectories) {
+            struct stat directoryStat;
+            if (stat(directory.first.c_str(), &directoryStat) < 0 ||
+                    directoryStat.st_mtim.tv_sec != directory.second.tv_sec ||
+                    directoryStat.st_mtim.tv_nsec != directory.second.tv_nsec) {
+                valid = false;
+                break;
+            }
+        }
+    }
+    if (valid) return;
+
+    //rebuild directory list from scratch
+    pathCache.clear();
+    pathDirectories.clear();
+    cachedPathVariable = currentPath;
+    std::istringstream directories(currentPath);
+    for (string directory; std::getline(directories, directory, ':');) {
+        if (directory.empty()) directory = ".";
+        struct timespec modificationTime = {0, 0};
+        struct stat directoryStat;
+        if (stat(directory.c_str(), &directoryStat) == 0) modificationTime = directoryStat.st_mtim;
+        pathDirectories.push_back(std::make_pair(directory, modificationTime));
+    }
+}
+
+string SmallShell::resolveCommandPath(const string &commandName) {
+    revalidatePathCache();
+
+    auto cached = pathCache.find(commandName);
+    if (cached != pathCache.end()) {
+        ++cached->second.hits;
+        return cached->second.path;
+    }
+
+    for (const auto &directory : pathDirectories) {
+        string candidate = directory.first + "/" + commandName;
+        struct stat candidateStat;
+        if (stat(candidate.c_str(), &candidateStat) < 0 || !S_ISREG(candidateStat.st_mode)) continue;
+        if (access(candidate.c_str(), X_OK) < 0) continue;
+
+        //relative directories depend on the working directory, so their results can't be remembered
+        if (directory.first[0] == '/') pathCache[commandName] = ResolvedPath{candidate, 1};
+        return candidate;
+    }
+    return "";
+}
+
+void SmallShell::printPathCache() const {
+    if (pathCache.empty()) {
+        cout << "hash: hash table empty" << endl;
+        return;
+    }
+    cout << "hits\tcommand" << endl;
+    for (const auto &entry : pathCache) {
+        cout << setw(4) << entry.second.hits << "\t" << entry.second.path << endl;
+    }
+}
+
+void SmallShell::resetPathCache() {
+    pathCache.clear();
+}
+
 SmallShell::~SmallShell() {
     if (foregroundProcess) {
         if (!::sendSignal(*foregroundProcess, SIGKILL)) std::cerr << "smash error: kill failed" << endl;
     }
-    executeCommand("quit");
 }
 /*
 bool SmallShell::getIsForgroundTimed() const {
@@ -347,38 +495,296 @@ signal_t SmallShell::escapeSmashProcessGroup() {
     return getpgrp();
 }
 
+void SmallShell::escapeSmashProcessGroup(pid_t pid) {
+    if (!inSmashProcessGroup()) return; //sons of helpers stay in the helper's group
+    //fails harmlessly if the son already exec'd after escaping by itself
+    setpgid(pid, pid);
+}
+
+bool SmallShell::inSmashProcessGroup() const {
+    return getpgrp() == smashProcessGroup;
+}
+
+/// \return the signals smash reads from its signal fd
+sigset_t _watchedSignals() {
+    sigset_t signals;
+    sigemptyset(&signals);
+    for (int signum : {SIGINT, SIGTSTP, SIGCHLD, SIGALRM}) sigaddset(&signals, signum);
+    return signals;
+}
 
-std::vector<std::string> initArgs(string cmd_line) {
-    const unsigned int MAX_ARGS = 20;
-    char **argsArray = (char **) malloc(MAX_ARGS * sizeof(char *));
-    const unsigned short numArgs = _parseCommandLine(_removeBackgroundSign(cmd_line), argsArray);
-    std::vector<std::string> args = vector<std::string>(argsArray, argsArray + numArgs);
+void SmallShell::watchSignals(bool lazily) {
+    const sigset_t signals = _watchedSignals();
+    //blocked signals stay pending until they are read from the signal fd
+    if (sigprocmask(SIG_BLOCK, &signals, nullptr) < 0) throw SmashExceptions::SyscallException("sigprocmask");
+    if (!lazily) openEventFds();
+}
 
-    for (unsigned short i = 0; i < numArgs; ++i) free(argsArray[i]);
-    free(argsArray);
+void SmallShell::openEventFds() {
+    const sigset_t signals = _watchedSignals();
+    signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signalFd < 0) throw SmashExceptions::SyscallException("signalfd");
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) throw SmashExceptions::SyscallException("epoll_create1");
+    for (int fd : {signalFd, jobs.getTimerFd()}) {
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) throw SmashExceptions::SyscallException("epoll_ctl");
+    }
+}
 
-    return args;
+void SmallShell::releaseSignals() {
+    const sigset_t signals = _watchedSignals();
+    //dispositions are the defaults already, as smash installs no handlers
+    sigprocmask(SIG_UNBLOCK, &signals, nullptr);
 }
 
-Command::Command(string cmd_line, SmallShell *smash) :
+void SmallShell::handleCtrlC() {
+    cout << "smash: got ctrl-C" << endl;
+    interruptSignal = SIGINT;
+
+    //send SIGKILL to foreground process
+    if (foregroundProcess) {
+        try{
+            ::sendSignal(*foregroundProcess, SIGKILL);
+        } catch (SmashExceptions::SyscallException& error){
+            cerr << error.what() << endl;
+        }
+        cout << "smash: process " << foregroundProcess->getProcessId() << " was killed" << endl;
+    }
+}
+
+void SmallShell::handleCtrlZ() {
+    cout << "smash: got ctrl-Z" << endl;
+    interruptSignal = SIGTSTP;
+
+    //send SIGSTOP to foreground process
+    if (foregroundProcess) {
+
+        //stop process
+        try{
+            ::sendSignal(*foregroundProcess, SIGSTOP);
+        } catch (SmashExceptions::SyscallException& error){
+            cerr << error.what() << endl;
+        }
+
+        cout << "smash: process " << foregroundProcess->getProcessId() << " was stopped" << endl;
+
+        //log that process is stopped
+        const_cast<ProcessControlBlock*>(foregroundProcess)->setRunning(false);
+
+        //add foreground command to jobs
+        jobs.addJob(*foregroundProcess);
+    }
+}
+
+void SmallShell::handleSignals() {
+    struct signalfd_siginfo signals[16];
+    while (true) {
+        const ssize_t bytesRead = read(signalFd, signals, sizeof(signals));
+        if (bytesRead < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN) return; //no more pending signals
+            throw SmashExceptions::SyscallException("read");
+        }
+        for (size_t i = 0; i < bytesRead / sizeof(signals[0]); ++i) {
+            switch (signals[i].ssi_signo) {
+                case SIGINT:
+                    handleCtrlC();
+                    break;
+                case SIGTSTP:
+                    handleCtrlZ();
+                    break;
+                case SIGCHLD:
+                    //only record the event - the children are reaped by JobsManager::removeFinishedJobs
+                    JobsManager::childStateChanged = true;
+                    break;
+                default: //SIGALRM - timeouts use the timer fd, but a stray alarm is no reason to die
+                    break;
+            }
+        }
+    }
+}
+
+bool SmallShell::waitEvents(int inputFd, int timeoutMilliseconds) {
+    if (epollFd < 0) openEventFds();
+    if (inputFd >= 0) {
+        //input is only waited for while smash wants to read it, or it would cut every other wait short
+        struct epoll_event inputEvent;
+        memset(&inputEvent, 0, sizeof(inputEvent));
+        inputEvent.events = EPOLLIN;
+        inputEvent.data.fd = inputFd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, inputFd, &inputEvent) < 0) {
+            if (errno == EPERM) return true; //a regular file, which can always be read
+            throw SmashExceptions::SyscallException("epoll_ctl");
+        }
+    }
+
+    struct epoll_event events[3];
+    int count;
+    do count = epoll_wait(epollFd, events, 3, timeoutMilliseconds);
+    while (count < 0 && errno == EINTR);
+    const int waitError = errno;
+    if (inputFd >= 0) epoll_ctl(epollFd, EPOLL_CTL_DEL, inputFd, nullptr);
+    if (count < 0) {
+        errno = waitError;
+        throw SmashExceptions::SyscallException("epoll_wait");
+    }
+
+    bool inputReady = false;
+    for (int event = 0; event < count; ++event) {
+        if (events[event].data.fd == signalFd) handleSignals();
+        else if (events[event].data.fd == jobs.getTimerFd()) jobs.handleTimeouts();
+        else inputReady = true;
+    }
+    return inputReady;
+}
+
+void SmallShell::pollEvents() {
+    if (epollFd >= 0) waitEvents(-1, 0);
+}
+
+bool SmallShell::readLine(std::string &line, void (*onIdle)(SmallShell &)) {
+    //the prompt is shown before waiting
+    cout.flush();
+    size_t searchStart = inputStart;
+    while (true) {
+        const size_t newline = inputBuffer.find('\n', searchStart);
+        if (newline != string::npos) {
+            line.assign(inputBuffer, inputStart, newline - inputStart);
+            inputStart = newline + 1;
+            return true;
+        }
+        inputBuffer.erase(0, inputStart);
+        inputStart = 0;
+        searchStart = inputBuffer.length();
+
+        bool inputReady = true;
+        //while there is history left to index, it is indexed a slice at a time until input comes
+        const bool indexing = indexingHistory && history.isRecording();
+        try {
+            inputReady = waitEvents(STDIN_FILENO, indexing ? 0 : -1);
+        } catch (SmashExceptions::SyscallException& error) {
+            std::perror(error.what());
+            fflush(stderr);
+        } catch (SmashExceptions::Exception &error) {
+            cerr << error.what() << endl;
+        }
+        if (!inputReady) {
+            if (onIdle) onIdle(*this);
+            if (indexing) {
+                try {
+                    indexingHistory = history.buildIndex();
+                } catch (SmashExceptions::Exception &error) {
+                    indexingHistory = false; //reported by the lookup that needs the history, if there is one
+                }
+            }
+            continue;
+        }
+
+        char chunk[4096];
+        const ssize_t bytesRead = read(STDIN_FILENO, chunk, sizeof(chunk));
+        if (bytesRead < 0) {
+            if (errno == EINTR || errno == EAGAIN) continue;
+            std::perror("smash error: read failed");
+            return false;
+        }
+        if (bytesRead == 0) {
+            //end of input, where the last line may lack its '\n'. Input read later (after ctrl-D) starts afresh
+            if (inputBuffer.empty()) return false;
+            line = inputBuffer;
+            inputBuffer.clear();
+            return true;
+        }
+        inputBuffer.append(chunk, bytesRead);
+    }
+}
+
+
+Command::Command(std::string_view cmd_line, SmallShell *smash) : Command(cmd_line, smash, true) {}
+
+Command::Command(std::string_view cmd_line, SmallShell *smash, bool tokenize) :
+    argsArena(&smash->lineArena),
+    args(&smash->lineArena),
     smash(smash),
-    cmd_line(cmd_line),
-    args(initArgs(cmd_line)) {}
+    cmd_line(cmd_line, &smash->lineArena),
+    literalWords(tokenize && _tokenize(cmd_line, argsArena, args)) {}
+
+void *Command::operator new(size_t size) {
+    return SmallShell::getInstance().lineArena.allocate(size);
+}
+
+void Command::operator delete(void *pointer) {
+    //freed with the rest of the line by LineArena::reset
+}
+
+void Command::executeInSon() {
+    execute();
+}
 
 void ChpromptCommand::execute() {
     smash->setSmashPrompt(newPrompt + "> ");
 }
 
-ChpromptCommand::ChpromptCommand(string cmd_line, SmallShell *smash) :
-        BuiltInCommand(cmd_line, smash), newPrompt((args.size() - 1 >= 1) ? args[1] : "smash") {}
+AfterCommand::AfterCommand(std::string_view cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {
+    // after [--any | --ignore-failure] <job-id>... <command>
+    size_t argument = 1;
+    for (; argument < args.size() && args[argument].substr(0, 2) == "--"; ++argument) {
+        if (args[argument] == "--any") policy = ANY_DEPENDENCY;
+        else if (args[argument] == "--ignore-failure") policy = IGNORE_FAILURES;
+        else throw SmashExceptions::InvalidArgumentsException("after");
+    }
+    for (; argument < args.size() && args[argument].find_first_not_of(DIGITS) == std::string_view::npos; ++argument) {
+        job_id_t jobId;
+        try {
+            jobId = stoi(string(args[argument]));
+        } catch (std::out_of_range &e) {
+            throw SmashExceptions::InvalidArgumentsException("after");
+        }
+        if (!smash->jobs.getJobById(jobId)) {
+            throw SmashExceptions::Exception("after", "job-id " + to_string(jobId) + " does not exist");
+        }
+        if (std::find(dependencies.begin(), dependencies.end(), jobId) == dependencies.end()) {
+            dependencies.push_back(jobId);
+        }
+    }
+    if (dependencies.empty() || argument >= args.size()) throw SmashExceptions::InvalidArgumentsException("after");
 
-ShowPidCommand::ShowPidCommand(string cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {}
+    //options and job-ids are plain words, so the command starts after as many words of the line
+    size_t position = 0;
+    for (size_t word = 0; word < argument; ++word) {
+        position = this->cmd_line.find_first_not_of(WHITESPACE, position);
+        position = this->cmd_line.find_first_of(WHITESPACE, position);
+    }
+    commandLine = _trim(string(this->cmd_line.substr(position)));
+}
+
+void AfterCommand::execute() {
+    //the command always runs in the background, once the jobs it waits for allow it
+    smash->jobs.addBlockedJob(_trim(string(cmd_line)) + " &", commandLine + " &", dependencies, policy);
+}
+
+ChpromptCommand::ChpromptCommand(std::string_view cmd_line, SmallShell *smash) :
+        BuiltInCommand(cmd_line, smash), newPrompt((args.size() - 1 >= 1) ? string(args[1]) : "smash") {}
+
+ShowPidCommand::ShowPidCommand(std::string_view cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {}
 
 void ShowPidCommand::execute() {
     cout << "smash pid is " << smash->smashPid << endl;
 }
 
-GetCurrDirCommand::GetCurrDirCommand(string cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {}
+GetCurrDirCommand::GetCurrDirCommand(std::string_view cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {}
+
+AllocationsCommand::AllocationsCommand(std::string_view cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {}
+
+void AllocationsCommand::execute() {
+    cout << "heap allocations: " << heapAllocationCount() << endl;
+    cout << "last line heap allocations: " << smash->lastLineHeapAllocations << endl;
+    cout << "last line arena allocations: " << smash->lastLineArenaAllocations << endl;
+    cout << "last line arena bytes: " << smash->lastLineArenaBytes << endl;
+}
 
 string GetCurrDirCommand::getCurrDir() {
     char *buf = (char *) malloc(sizeof(char) * (1+PATH_MAX));
@@ -398,11 +804,16 @@ string GetCurrDirCommand::getCurrDir() {
 }
 
 void GetCurrDirCommand::execute() {
-    string currDir = getCurrDir();
-    if (currDir != "") cout << currDir << endl;
+    //printed straight from the stack, sparing the string of getCurrDir
+    char currDir[PATH_MAX];
+    if (!getcwd(currDir, PATH_MAX)) {
+        perror("smash error: getcwd failed\n");
+        return;
+    }
+    cout << currDir << endl;
 }
 
-ChangeDirCommand::ChangeDirCommand(string cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line,
+ChangeDirCommand::ChangeDirCommand(std::string_view cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line,
                                                                                         smash) {}
 
 void ChangeDirCommand::execute() {
@@ -417,7 +828,7 @@ void ChangeDirCommand::execute() {
 
     string oldPath = GetCurrDirCommand::getCurrDir();
 
-    string targetPath = (args[1] == "-") ? smash->getLastPwd() : args[1];
+    string targetPath = (args[1] == "-") ? smash->getLastPwd() : string(args[1]);
     if (!chdir(targetPath.c_str())) {
         smash->setLastPwd(oldPath);
         return;
@@ -426,73 +837,423 @@ void ChangeDirCommand::execute() {
     throw SmashExceptions::SyscallException("chdir");
 }
 
-JobsCommand::JobsCommand(string cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {}
+JobsCommand::JobsCommand(std::string_view cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {
+    if (args.size() - 1 == 0) return;
+    if (args[1] == "-v" && args.size() - 1 == 1) {
+        usageRequest = true;
+        return;
+    }
+    if (args[1] != "--limit" || args.size() - 1 > 2) throw SmashExceptions::InvalidArgumentsException("jobs");
+    limitRequest = true;
+    if (args.size() - 1 == 2) {
+        try {
+            const int requestedLimit = stoi(string(args[2]));
+            if (requestedLimit < 0) throw std::invalid_argument("negative limit");
+            limit = requestedLimit;
+        } catch (std::logic_error &e) {
+            throw SmashExceptions::InvalidArgumentsException("jobs");
+        }
+        setLimit = true;
+    }
+}
 
 void JobsCommand::execute() {
-    smash->jobs.printJobsList();
+    if (!limitRequest) {
+        smash->jobs.printJobsList(usageRequest);
+        return;
+    }
+    if (setLimit) {
+        smash->jobs.setRunningLimit(limit);
+        smash->jobs.startQueuedJobs();
+        return;
+    }
+    const unsigned runningLimit = smash->jobs.getRunningLimit();
+    cout << "limit: " << (runningLimit ? to_string(runningLimit) : "none") << endl;
+}
+
+bool JobsManager::childStateChanged = false;
+
+/// \return the status waitpid would have reported for the child state change described by childInfo
+int _waitStatusOf(const siginfo_t &childInfo) {
+    switch (childInfo.si_code) {
+        case CLD_EXITED:
+            return W_EXITCODE(childInfo.si_status, 0);
+        case CLD_STOPPED:
+        case CLD_TRAPPED:
+            return W_STOPCODE(childInfo.si_status);
+        case CLD_DUMPED:
+            return childInfo.si_status | WCOREFLAG;
+        default: //CLD_KILLED
+            return childInfo.si_status;
+    }
 }
 
+/// \return description of a child state change, as waitid would have reported the change of wait status
+siginfo_t _childInfoOf(pid_t pid, int waitStatus) {
+    siginfo_t childInfo;
+    memset(&childInfo, 0, sizeof(childInfo));
+    childInfo.si_pid = pid;
+    if (WIFSTOPPED(waitStatus)) {
+        childInfo.si_code = CLD_STOPPED;
+        childInfo.si_status = WSTOPSIG(waitStatus);
+    } else if (WIFSIGNALED(waitStatus)) {
+        childInfo.si_code = WCOREDUMP(waitStatus) ? CLD_DUMPED : CLD_KILLED;
+        childInfo.si_status = WTERMSIG(waitStatus);
+    } else {
+        childInfo.si_code = CLD_EXITED;
+        childInfo.si_status = WEXITSTATUS(waitStatus);
+    }
+    return childInfo;
+}
+
+/// Drains every pending child state change (exit, stop, continue) and applies it to the affected job only.
+/// Cost is proportional to the number of state changes since the last call rather than to the number of jobs.
 void JobsManager::removeFinishedJobs() {
-    std::list<job_id_t> targets;
-    for (pair<job_id_t, ProcessControlBlock> job : processes) {
-        if (waitpid(job.second.getProcessId(), nullptr, WNOHANG | WUNTRACED)<0) throw SmashExceptions::SyscallException("waitpid");
-        int killStatus = kill(job.second.getProcessId(), 0);
-        if (killStatus < 0 && errno == 3) {
-            targets.push_back(job.first);
-        } else if (killStatus < 0) {
-            throw SmashExceptions::SyscallException("kill");
+    if (!childStateChanged) return;
+    childStateChanged = false; //cleared before draining, so a SIGCHLD read mid-drain is not lost
+    TraceScope trace(TRACE_REMOVE_FINISHED_JOBS);
+
+    while (true) {
+        siginfo_t childInfo;
+        childInfo.si_pid = 0;
+        struct rusage usage;
+        memset(&usage, 0, sizeof(usage));
+        //the system call rather than the libc wrapper, which doesn't return the resource usage of the child
+        if (syscall(SYS_waitid, P_ALL, 0, &childInfo, WNOHANG | WEXITED | WSTOPPED | WCONTINUED, &usage) < 0) {
+            if (errno == EINTR) continue;
+            if (errno == ECHILD) break; //no children at all
+            throw SmashExceptions::SyscallException("waitid");
         }
+        if (childInfo.si_pid == 0) break; //no more pending state changes
+
+        applyChildStateChange(childInfo, usage);
+    }
+}
+
+void JobsManager::applyChildStateChange(const siginfo_t &childInfo, const struct rusage &usage) {
+    auto jobEntry = pidIndex.find(childInfo.si_pid);
+    if (jobEntry == pidIndex.end()) {
+        //not a job - someone is (or will be) waiting for it with waitChild
+        if (childInfo.si_code != CLD_CONTINUED) {
+            unclaimedChildren[childInfo.si_pid] = ReapedChild{_waitStatusOf(childInfo), usage};
+        }
+        return;
     }
-    for (job_id_t jobId : targets) {
-        waitingHeap.erase(&processes.at(jobId));
-        processes.erase(jobId);
+
+    ProcessControlBlock *pcb = jobTable.get(jobEntry->second);
+    assert(pcb);
+    const job_id_t jobId = pcb->getJobId();
+    switch (childInfo.si_code) {
+        case CLD_STOPPED:
+        case CLD_TRAPPED:
+            if (pcb->isRunning()) pauseJob(jobId);
+            break;
+        case CLD_CONTINUED:
+            if (!pcb->isRunning()) registerUnpauseJob(jobId);
+            break;
+        default: //CLD_EXITED, CLD_KILLED, CLD_DUMPED
+            pidIndex.erase(jobEntry);
+            pcb->addUsage(usage);
+            //job is done once every stage of it exited
+            if (!pcb->removeProcessId(childInfo.si_pid)) {
+                cancelTimeout(pcb->getProcessId());
+                const int waitStatus = _waitStatusOf(childInfo);
+                pcb->setFinished(waitStatus);
+                recordFinishedJob(*pcb);
+                if (listener) listener->jobFinished(*pcb, waitStatus);
+                const std::vector<uint64_t> dependents = pcb->getDependents();
+                eraseJob(jobId);
+                if (!dependents.empty()) resolveDependents(dependents, _exitStatus(waitStatus) == 0);
+            }
     }
 }
 
-void JobsManager::printJobsList() {
+pid_t JobsManager::waitChild(pid_t pid, int *status, int options, struct rusage *usage) {
+    while (true) {
+        auto reaped = unclaimedChildren.find(pid);
+        if (reaped != unclaimedChildren.end()) {
+            const ReapedChild reapedChild = reaped->second;
+            unclaimedChildren.erase(reaped);
+            if (!WIFSTOPPED(reapedChild.status) || (options & WUNTRACED)) {
+                if (status) *status = reapedChild.status;
+                if (usage) *usage = reapedChild.usage;
+                return pid;
+            }
+        }
+
+        pid_t result = wait4(pid, status, options, usage);
+        if (result >= 0) return result;
+        if (errno == EINTR) continue;
+        //removeFinishedJobs may have drained the child's status in the meantime
+        if (errno == ECHILD && unclaimedChildren.count(pid)) continue;
+        return result;
+    }
+}
+
+/// print the resources a job used, as: user <secs> sys <secs> maxrss <KB> csw <voluntary>/<involuntary>
+void _printUsage(const ProcessControlBlock &pcb) {
+    const struct rusage &usage = pcb.getUsage();
+    char text[160];
+    snprintf(text, sizeof(text), " user %ld.%03lds sys %ld.%03lds maxrss %ldKB csw %ld/%ld",
+             (long) usage.ru_utime.tv_sec, (long) usage.ru_utime.tv_usec / 1000,
+             (long) usage.ru_stime.tv_sec, (long) usage.ru_stime.tv_usec / 1000,
+             usage.ru_maxrss, usage.ru_nvcsw, usage.ru_nivcsw);
+    cout << text;
+}
+
+void JobsManager::recordFinishedJob(const ProcessControlBlock &pcb) {
+    finishedJobs.push_back(pcb);
+    if (finishedJobs.size() > HISTORY_MAX_RECORDS) finishedJobs.pop_front();
+}
+
+void JobsManager::printJobsList(bool showUsage) {
     removeFinishedJobs();
 
-    for (pair<job_id_t, ProcessControlBlock> job : processes) {
-        ProcessControlBlock &pcb = job.second;
+    startQueuedJobs();
+
+    for (job_id_t jobId = 1; jobId <= maxIndex; ++jobId) {
+        ProcessControlBlock *job = jobTable.get(jobHandles[jobId]);
+        if (!job) continue;
+        ProcessControlBlock &pcb = *job;
+        if (pcb.isQueued()) {
+            cout << "[" << pcb.getJobId() << "] " << pcb.getCreatingCommand();
+            auto blocked = blockedJobs.find(jobHandles[jobId]);
+            if (blocked == blockedJobs.end()) cout << " (queued)" << endl;
+            else {
+                cout << " (waiting for";
+                for (job_id_t dependency : blocked->second.dependencies) cout << " " << dependency;
+                cout << ")" << endl;
+            }
+            continue;
+        }
         cout << "[" << pcb.getJobId() << "] " << pcb
              << " " << difftime(time(nullptr), pcb.getStartTime()) << " secs"
-             << ((pcb.isRunning()) ? "" : " (stopped)") << endl;
+             << ((pcb.isRunning()) ? "" : " (stopped)");
+        //resources of the stages that finished so far
+        if (showUsage) _printUsage(pcb);
+        cout << endl;
+    }
+
+    if (!showUsage || finishedJobs.empty()) return;
+    cout << "finished:" << endl;
+    for (const ProcessControlBlock &pcb : finishedJobs) {
+        cout << "[" << pcb.getJobId() << "] " << pcb.getCreatingCommand() << " : " << pcb.getProcessId()
+             << " " << difftime(pcb.getFinishTime(), pcb.getStartTime()) << " secs status "
+             << _exitStatus(pcb.getWaitStatus());
+        _printUsage(pcb);
+        cout << endl;
     }
 }
 
 ProcessControlBlock *JobsManager::getJobById(job_id_t jobId) {
-    try {
-        return &processes.at(jobId);
-    } catch (std::out_of_range) {
-        return nullptr;
-    }
+    if (jobId <= 0 || jobId >= (job_id_t) jobHandles.size()) return nullptr;
+    return jobTable.get(jobHandles[jobId]);
 }
 
 bool JobsManager::isEmpty() {
-    return processes.empty();
+    return jobTable.empty();
 }
 
-ProcessControlBlock *JobsManager::getLastJob() {
-    return &((--processes.end())->second);
+JobListener *JobsManager::getListener() const {
+    return listener;
 }
 
-void JobsManager::removeJobById(job_id_t jobId) {
-    //remove from waiting list
-    waitingHeap.erase(&processes.at(jobId));
-    //remove from map
-    processes.erase(jobId);
-    // remove from timed_processes list
-    auto it = timed_processes.begin();
-    while (it != timed_processes.end()) {
-        if (it->getJobId() == jobId) {
-            it = timed_processes.erase(it);
-            //return;
-        } else {
-            ++it;
+void JobsManager::setListener(JobListener *listener) {
+    JobsManager::listener = listener;
+}
+
+size_t JobsManager::runningJobCount() const {
+    return jobTable.size() - queuedJobs.size() - blockedJobs.size() - waitingHeap.size();
+}
+
+unsigned JobsManager::getRunningLimit() const {
+    return runningLimit;
+}
+
+void JobsManager::setRunningLimit(unsigned runningLimit) {
+    JobsManager::runningLimit = runningLimit;
+}
+
+bool JobsManager::mustQueue() const {
+    if (!runningLimit || listener || reservedJobId != UNINITIALIZED_JOB_ID) return false;
+    //jobs don't overtake the queue, even when a slot is free by now
+    return !queuedJobs.empty() || runningJobCount() >= runningLimit;
+}
+
+void JobsManager::queueJob(const string &creatingCommand, const string &launchCommandLine) {
+    ProcessControlBlock pcb = ProcessControlBlock(UNINITIALIZED_JOB_ID, 0, creatingCommand);
+    pcb.setProcessIds(std::vector<pid_t>());
+    pcb.setQueued(true);
+    addJob(pcb);
+    queuedJobs.push_back(QueuedJob{pcb.getJobId(), launchCommandLine});
+}
+
+void JobsManager::startQueuedJobs() {
+    //launching a job comes back here through addJob, which must not launch the next ones meanwhile
+    if (reservedJobId != UNINITIALIZED_JOB_ID) return;
+
+    while (!queuedJobs.empty() && (!runningLimit || runningJobCount() < runningLimit)) {
+        const QueuedJob next = queuedJobs.front();
+        //from here on the job counts as running
+        queuedJobs.pop_front();
+
+        //the launched job replaces the queued one under the same job_id
+        reservedJobId = next.jobId;
+        smash.containedExecute(smash.containedBuild(next.cmd_line));
+        reservedJobId = UNINITIALIZED_JOB_ID;
+
+        //nothing was launched
+        ProcessControlBlock *pcb = getJobById(next.jobId);
+        if (pcb && pcb->isQueued()) dropJob(next.jobId);
+    }
+}
+
+string JobsManager::takeQueuedJob(job_id_t jobId) {
+    string result;
+    auto blocked = blockedJobs.find(jobHandles[jobId]);
+    if (blocked != blockedJobs.end()) result = blocked->second.cmd_line;
+    for (const QueuedJob &queuedJob : queuedJobs) {
+        if (queuedJob.jobId == jobId) result = queuedJob.cmd_line;
+    }
+    eraseJob(jobId);
+    return result;
+}
+
+void JobsManager::addBlockedJob(const string &creatingCommand, const string &launchCommandLine,
+                                const std::vector<job_id_t> &dependencies, DependencyPolicy policy) {
+    ProcessControlBlock pcb = ProcessControlBlock(UNINITIALIZED_JOB_ID, 0, creatingCommand);
+    pcb.setProcessIds(std::vector<pid_t>());
+    pcb.setQueued(true);
+    addJob(pcb);
+
+    //dependencies are existing jobs, which can't depend on a job added after them, so the graph never has a cycle
+    const job_handle_t handle = jobHandles[pcb.getJobId()];
+    blockedJobs[handle] = BlockedJob{launchCommandLine, dependencies, policy, dependencies.size()};
+    for (job_id_t dependency : dependencies) getJobById(dependency)->addDependent(handle);
+}
+
+void JobsManager::resolveDependents(const std::vector<uint64_t> &dependents, bool succeeded) {
+    //waiting jobs, each with whether the job it waited for succeeded
+    std::vector<std::pair<job_handle_t, bool> > pending;
+    for (job_handle_t dependent : dependents) pending.push_back(std::make_pair(dependent, succeeded));
+
+    while (!pending.empty()) {
+        const std::pair<job_handle_t, bool> next = pending.back();
+        pending.pop_back();
+        auto blocked = blockedJobs.find(next.first);
+        if (blocked == blockedJobs.end()) continue; //launched by fg, or already queued or dropped
+
+        BlockedJob &job = blocked->second;
+        --job.unfinished;
+        bool ready = false, failed = false;
+        switch (job.policy) {
+            case ALL_DEPENDENCIES:
+                failed = !next.second;
+                ready = !failed && job.unfinished == 0;
+                break;
+            case ANY_DEPENDENCY:
+                ready = next.second;
+                failed = !ready && job.unfinished == 0;
+                break;
+            case IGNORE_FAILURES:
+                ready = job.unfinished == 0;
+                break;
         }
+        if (!ready && !failed) continue;
+
+        ProcessControlBlock &pcb = *jobTable.get(next.first);
+        if (ready) {
+            queuedJobs.push_back(QueuedJob{pcb.getJobId(), std::move(job.cmd_line)});
+            blockedJobs.erase(blocked);
+            continue;
+        }
+        cerr << "smash error: after: job-id " << pcb.getJobId() << " dropped, a job it waits for failed" << endl;
+        for (job_handle_t dependent : pcb.getDependents()) pending.push_back(std::make_pair(dependent, false));
+        eraseJob(pcb.getJobId());
     }
 }
 
+void JobsManager::dropJob(job_id_t jobId) {
+    const std::vector<uint64_t> dependents = getJobById(jobId)->getDependents();
+    eraseJob(jobId);
+    resolveDependents(dependents, false);
+}
+
+void JobsManager::waitQueuedJobs() {
+    SmallShell::interruptSignal = 0;
+    while (true) {
+        removeFinishedJobs();
+        startQueuedJobs();
+        if ((queuedJobs.empty() && blockedJobs.empty()) || SmallShell::interruptSignal) return;
+        waitChildStateChange();
+    }
+}
+
+void JobsManager::waitChildStateChange() {
+    //a SIGCHLD that came before the wait stays readable on the signal fd, so it is never missed
+    while (!childStateChanged && !SmallShell::interruptSignal) smash.waitEvents();
+}
+
+ProcessControlBlock *JobsManager::getLastJob() {
+    return getJobById(maxIndex);
+}
+
+int JobsManager::waitForeground(ProcessControlBlock &pcb) {
+    //only smash itself stops waiting when the job is stopped - a helper waits for its sons to really finish
+    const int options = smash.inSmashProcessGroup() ? WUNTRACED : NO_OPTIONS;
+    //smash handles ctrl-C, ctrl-Z and timeouts meanwhile, while a helper has no events of its own and just blocks
+    const bool handleEvents = (getpid() == smash.smashPid);
+    TraceScope trace(TRACE_WAIT);
+    int status = 0;
+    while (!pcb.getProcessIds().empty()) {
+        const pid_t pid = pcb.getProcessIds().front();
+        struct rusage usage;
+        const pid_t result = waitChild(pid, &status, options | (handleEvents ? WNOHANG : NO_OPTIONS), &usage);
+        if (result < 0) throw SmashExceptions::SyscallException("waitpid");
+        if (result == 0) {
+            //ctrl-Z stopped the job, and made it a job whose stop event removeFinishedJobs may already have applied
+            if (!pcb.isRunning()) {
+                status = W_STOPCODE(SIGSTOP);
+                break;
+            }
+            smash.waitEvents();
+            //jobs that finish meanwhile free their slots for queued jobs, however long the foreground job takes.
+            //Without any, the sweep (which waitid makes linear in the number of sons) waits for the next prompt
+            if (!queuedJobs.empty() || !blockedJobs.empty()) {
+                removeFinishedJobs();
+                startQueuedJobs();
+            }
+            continue;
+        }
+        if (WIFSTOPPED(status)) break;
+        pcb.addUsage(usage);
+        pcb.removeProcessId(pid);
+    }
+    return status;
+}
+
+void JobsManager::eraseJob(job_id_t jobId) {
+    ProcessControlBlock &pcb = *getJobById(jobId);
+    if (pcb.isQueued() && !blockedJobs.erase(jobHandles[jobId])) {
+        //linear in the length of the queue, but only for a queued job removed by hand (fg, kill)
+        queuedJobs.remove_if([jobId](const QueuedJob &queuedJob) { return queuedJob.jobId == jobId; });
+    }
+    //remove from waiting list
+    waitingHeap.erase(&pcb);
+    //remove from pid index
+    for (pid_t pid : pcb.getProcessIds()) pidIndex.erase(pid);
+    //remove from job table
+    jobTable.release(jobHandles[jobId]);
+    jobHandles[jobId] = Slab<ProcessControlBlock>::NO_HANDLE;
+    //amortized O(1) - only adding a job, which is O(1), moves maxIndex up past the unused job_ids again
+    while (maxIndex > 0 && jobHandles[maxIndex] == Slab<ProcessControlBlock>::NO_HANDLE) --maxIndex;
+}
+
+void JobsManager::removeJobById(job_id_t jobId) {
+    //a timeout of the job stays, as it still applies when the job is brought to the foreground
+    eraseJob(jobId);
+}
+
 void JobsManager::pauseJob(job_id_t jobId) {
     ProcessControlBlock *pcb = getJobById(jobId);
     assert(pcb);
@@ -501,11 +1262,9 @@ void JobsManager::pauseJob(job_id_t jobId) {
 }
 
 void JobsManager::unpauseJob(job_id_t jobId) {
-    //send SIGCONT
-    bool signalSendStatus = smash.sendSignal(SIGCONT, jobId);
-    assert(signalSendStatus);
-
-    registerUnpauseJob(jobId);
+    //send SIGCONT, which registers the job as running as well
+    const std::vector<JobSignalResult> results = signalJobs(SIGCONT, ALL_JOBS, jobId, jobId);
+    assert(results.size() == 1 && !results.front().error);
 }
 void JobsManager::registerUnpauseJob(job_id_t jobId) {
     ProcessControlBlock *pcb = getJobById(jobId);
@@ -517,80 +1276,187 @@ void JobsManager::registerUnpauseJob(job_id_t jobId) {
     waitingHeap.erase(pcb);
 }
 
-JobsManager::JobsManager(SmallShell &smash) : smash(smash) {}
+JobsManager::JobsManager(SmallShell &smash) : timeouts(monotonicMilliseconds()), smash(smash) {}
 
 ProcessControlBlock *JobsManager::getLastStoppedJob() {
     if (waitingHeap.empty()) throw SmashExceptions::NoStoppedJobsException();
-    ProcessControlBlock *result = waitingHeap.getMax();
+    ProcessControlBlock *result = waitingHeap.top();
     assert(result);
     return result;
 }
 
 void JobsManager::killAllJobs() {
-    cout << "smash: sending SIGKILL signal to " << processes.size() << " jobs:" << endl;
-    for (pair<job_id_t, ProcessControlBlock> pcbPair : processes) {
-        cout << pcbPair.second.getProcessId() << ": " << pcbPair.second.getCreatingCommand() << endl;
-        bool signalStatus = smash.sendSignal(SIGKILL, pcbPair.first);
-        assert (signalStatus);
+    //the list is flushed once, rather than a line at a time
+    cout << "smash: sending SIGKILL signal to " << jobTable.size() << " jobs:" << '\n';
+    for (job_id_t jobId = 1; jobId <= maxIndex; ++jobId) {
+        const ProcessControlBlock *pcb = jobTable.get(jobHandles[jobId]);
+        if (!pcb) continue;
+        cout << (pcb->isQueued() ? "queued" : to_string(pcb->getProcessId())) << ": " << pcb->getCreatingCommand()
+             << '\n';
+    }
+    cout.flush();
+    for (const JobSignalResult &result : signalJobs(SIGKILL)) {
+        if (result.error) {
+            errno = result.error;
+            perror("smash error: kill failed");
+        }
     }
     // ROI erase also all timed processes
-    smash.jobs.timed_processes.clear();
+    timeouts.clear();
+    timeoutIndex.clear();
+}
+
+std::vector<JobSignalResult> JobsManager::signalJobs(signal_t signum, JobStateFilter states, job_id_t firstJobId,
+                                                     job_id_t lastJobId) {
+    //if this is wait/continue signal, update the jobs as well
+    const bool stopSignal = (signum==SIGSTOP || signum==SIGTSTP || signum==SIGTTIN || signum==SIGTTOU);
+    const bool contSignal = (signum==SIGCONT);
+    //a queued job is only dropped by a signal whose default action would end it - not by one that stops, continues
+    //or is ignored by default
+    const bool ignoredSignal = (signum==0 || signum==SIGCHLD || signum==SIGURG || signum==SIGWINCH);
+
+    std::vector<JobSignalResult> results;
+    //dropping queued jobs only ever lowers maxIndex, and leaves the job_ids of the dropped jobs unused
+    lastJobId = std::min(lastJobId, maxIndex);
+    for (job_id_t jobId = std::max(firstJobId, 1); jobId <= lastJobId; ++jobId) {
+        ProcessControlBlock *pcb = jobTable.get(jobHandles[jobId]);
+        if (!pcb) continue;
+        if (states != ALL_JOBS && (pcb->isQueued() || pcb->isRunning() != (states == RUNNING_JOBS))) continue;
+
+        if (pcb->isQueued()) {
+            //no process to signal yet - a signal that would end the job drops it from the queue instead
+            results.push_back(JobSignalResult{jobId, 0, 0});
+            if (!stopSignal && !contSignal && !ignoredSignal) dropJob(jobId);
+            continue;
+        }
+
+        //the job is a son smash didn't reap yet, so its process group can't have been recycled for another one
+        const pid_t processGroupId = pcb->getProcessGroupId();
+        const int error = (killpg(processGroupId, signum) < 0) ? errno : 0;
+        results.push_back(JobSignalResult{jobId, processGroupId, error});
+        if (error) continue;
+
+        if (stopSignal && pcb->isRunning()) pauseJob(jobId);
+        if (contSignal) registerUnpauseJob(jobId);
+    }
+    return results;
 }
 
-void JobsManager::addJob(const Command &cmd, pid_t pid) {
-    addJob(ProcessControlBlock(UNINITIALIZED_JOB_ID, pid, cmd.cmd_line));
+void JobsManager::addJob(const Command &cmd, const std::vector<pid_t>& pids) {
+    //a job launched from the queue keeps its job_id
+    ProcessControlBlock pcb = ProcessControlBlock(reservedJobId, pids.front(), string(cmd.cmd_line));
+    pcb.setProcessIds(pids);
+    addJob(pcb);
 }
 
 void JobsManager::addJob(const ProcessControlBlock &pcb) {
     removeFinishedJobs();
 
-    resetMaxIndex();
     const_cast<ProcessControlBlock &>(pcb).resetStartTime();
 
     job_id_t newJobId = pcb.getJobId();
-    if (newJobId == UNINITIALIZED_JOB_ID || newJobId==FG_JOB_ID) newJobId = ++maxIndex;
+    if (newJobId == UNINITIALIZED_JOB_ID || newJobId==FG_JOB_ID) newJobId = maxIndex + 1;
     const_cast<ProcessControlBlock &>(pcb).setJobId(newJobId);
-    processes.erase(newJobId); //new element should overwrite old element
-    processes.insert(pair<job_id_t,
-            ProcessControlBlock>(newJobId, pcb));
+    if (ProcessControlBlock *replaced = getJobById(newJobId)) { //new element should overwrite old element
+        //a job launched from the queue takes over the jobs waiting for it
+        if (replaced->isQueued()) const_cast<ProcessControlBlock &>(pcb).setDependents(replaced->getDependents());
+        eraseJob(newJobId);
+    }
+    if (newJobId >= (job_id_t) jobHandles.size()) jobHandles.resize(newJobId + 1, Slab<ProcessControlBlock>::NO_HANDLE);
+    const job_handle_t handle = jobTable.allocate(pcb);
+    jobHandles[newJobId] = handle;
+    if (newJobId > maxIndex) maxIndex = newJobId;
+    for (pid_t pid : pcb.getProcessIds()) pidIndex[pid] = handle;
 
     //if process is stopped, handle it as such
     if (!pcb.isRunning()) {
         pauseJob(pcb.getJobId());
     }
-}
 
-job_id_t JobsManager::resetMaxIndex() {
-    maxIndex += 2; //for safety
-    while (maxIndex > 0 && !getJobById(maxIndex)) {
-        --maxIndex;
+    if (listener) listener->jobAdded(*jobTable.get(handle));
+
+    //processes that changed state before they became a job were reaped as children nobody claimed yet. Those of the
+    //foreground job stopped by ctrl-Z are left to waitForeground, which is still waiting for them
+    const ProcessControlBlock *foreground = smash.getForegroundProcess();
+    for (pid_t pid : pcb.getProcessIds()) {
+        auto reaped = unclaimedChildren.find(pid);
+        if (reaped == unclaimedChildren.end()) continue;
+        if (foreground && std::find(foreground->getProcessIds().begin(), foreground->getProcessIds().end(), pid) !=
+                          foreground->getProcessIds().end()) continue;
+        const siginfo_t childInfo = _childInfoOf(pid, reaped->second.status);
+        const struct rusage usage = reaped->second.usage;
+        unclaimedChildren.erase(reaped);
+        applyChildStateChange(childInfo, usage);
     }
-    return maxIndex;
 }
 
 void JobsManager::addTimedProcess(const job_id_t jobId,
                                   const pid_t processId,
-                                  const std::string& creatingCommand, int futureSeconds, bool flag){
-    TimedProcessControlBlock timed_pcb = TimedProcessControlBlock(jobId, processId, creatingCommand, futureSeconds, flag);
-    timed_processes.push_front(timed_pcb);
-    //sort processes by futureTime
-    timed_processes.sort();
+                                  const std::string& creatingCommand, uint64_t timeoutMilliseconds, bool flag){
+    const uint64_t abortTime = monotonicMilliseconds() + timeoutMilliseconds;
+    TimerWheel<TimedProcessControlBlock>::handle_t timer = timeouts.schedule(abortTime,
+            TimedProcessControlBlock(jobId, processId, creatingCommand, abortTime, flag));
+    //built-in commands have no process to cancel the timeout of
+    if (processId > 0) timeoutIndex[processId] = timer;
+}
+
+void JobsManager::cancelTimeout(pid_t processId) {
+    if (timeoutIndex.empty()) return; //spare the lookup for the many jobs without a timeout
+    auto timeout = timeoutIndex.find(processId);
+    if (timeout == timeoutIndex.end()) return;
+    timeouts.cancel(timeout->second);
+    timeoutIndex.erase(timeout);
+    //the timer fd is left armed - waking up without due timeouts costs less than re-arming on every cancel
+}
+
+int JobsManager::getTimerFd() {
+    if (timerFd < 0) {
+        timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timerFd < 0) throw SmashExceptions::SyscallException("timerfd_create");
+    }
+    return timerFd;
 }
 
-void JobsManager::setAlarmSignal(){
-    if (timed_processes.empty()) return;
-    assert(!timed_processes.empty());
-    timed_processes.sort();
-    int alarmNumber = (int)difftime(timed_processes.begin()->getAbortTime(),time(nullptr));
-    assert(alarmNumber > 0);
-    alarm(alarmNumber);
+void JobsManager::armTimeoutTimer() {
+    //all zeros disarms the timer
+    struct itimerspec timerTime;
+    memset(&timerTime, 0, sizeof(timerTime));
+    const uint64_t wakeup = timeouts.nextWakeup();
+    if (wakeup != UINT64_MAX) {
+        timerTime.it_value.tv_sec = wakeup / 1000;
+        timerTime.it_value.tv_nsec = (wakeup % 1000) * 1000000;
+    }
+    if (timerfd_settime(getTimerFd(), TFD_TIMER_ABSTIME, &timerTime, nullptr) < 0)
+        throw SmashExceptions::SyscallException("timerfd_settime");
 }
 
-KillCommand::KillCommand(string cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {
+void JobsManager::handleTimeouts() {
+    uint64_t expirations;
+    //clears the timer fd, which is re-armed for the next deadline below
+    if (read(getTimerFd(), &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+        throw SmashExceptions::SyscallException("read");
+    }
+
+    //every deadline that passed since the last wakeup is handled at once
+    std::vector<TimedProcessControlBlock> expired;
+    timeouts.expire(monotonicMilliseconds(), expired);
+
+    if (!expired.empty()) cout << "smash: got an alarm" << endl;
+    for (TimedProcessControlBlock &timedPcb : expired) {
+        if (timedPcb.getProcessId() <= 0) continue; //built-in command, nothing to kill
+        timeoutIndex.erase(timedPcb.getProcessId());
+        if (::sendSignal(timedPcb, SIGKILL)) {
+            cout << "smash: " << timedPcb.getCreatingCommand() << " timed out!" << endl;
+        }
+    }
+    armTimeoutTimer();
+}
+
+KillCommand::KillCommand(std::string_view cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {
     try {
         if ((args.size() - 1 != 2) || (args[1][0] != '-')) throw std::invalid_argument("Bad args");
-        signum = -stoi(args[1]);
-        jobId = stoi(args[2]);
+        signum = -stoi(string(args[1]));
+        jobId = stoi(string(args[2]));
         if (signum>31) throw SmashExceptions::InvalidArgumentsException("kill");
     } catch (std::invalid_argument& e) {
         throw SmashExceptions::InvalidArgumentsException("kill");
@@ -603,29 +1469,33 @@ void KillCommand::execute() {
         throw SmashExceptions::Exception("kill", "job-id " + to_string(jobId) + " does not exist");
     }
 
-    bool signalSendStatus = ::sendSignal(*pcbPtr, signum);
-    if (!signalSendStatus) {
+    const bool queued = pcbPtr->isQueued();
+    const pid_t pid = pcbPtr->getProcessId();
+    const JobSignalResult result = smash->jobs.signalJobs(signum, ALL_JOBS, jobId, jobId).front();
+    if (result.error) {
         if (!verbose) throw SmashExceptions::SignalSendException();
+        errno = result.error;
         throw SmashExceptions::SyscallException("kill");
     }
 
-    //if this is wait/continue signal, update JobsManager as well
-    bool stopSignal = (signum==SIGSTOP || signum==SIGTSTP || signum==SIGTTIN || signum==SIGTTOU);
-    bool contSignal = (signum==SIGCONT);
-    if (stopSignal) smash->jobs.pauseJob(jobId);
-    if (contSignal) smash->jobs.registerUnpauseJob(jobId);
-
-    if (verbose) cout << "signal number " << signum << " was sent to pid " << pcbPtr->getProcessId() << endl;
+    if (!verbose) return;
+    if (queued) cout << "signal number " << signum << " was sent to queued job-id " << jobId << endl;
+    else cout << "signal number " << signum << " was sent to pid " << pid << endl;
 }
 
-BuiltInCommand::BuiltInCommand(string cmd_line, SmallShell *smash) : Command(_removeBackgroundSign(cmd_line), smash){
+BuiltInCommand::BuiltInCommand(std::string_view cmd_line, SmallShell *smash) : Command(cmd_line, smash){
     isBuiltIn = true;
+    //built-in commands run in smash itself, so a background sign means nothing to them
+    const size_t backgroundSign = this->cmd_line.find_last_not_of(WHITESPACE);
+    if (backgroundSign != string::npos && this->cmd_line[backgroundSign] == '&') {
+        this->cmd_line.resize(backgroundSign);
+    }
 }
 
-ForegroundCommand::ForegroundCommand(string cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {
+ForegroundCommand::ForegroundCommand(std::string_view cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {
     try {
         if (args.size() - 1 > 1) throw std::invalid_argument("Too many args");
-        if (args.size() - 1 != 0) jobId = stoi(args[1]);
+        if (args.size() - 1 != 0) jobId = stoi(string(args[1]));
     } catch (std::invalid_argument& e) {
         throw SmashExceptions::InvalidArgumentsException("fg");
     }
@@ -638,6 +1508,21 @@ ForegroundCommand::ForegroundCommand(string cmd_line, SmallShell *smash) : Built
 }
 
 void ForegroundCommand::execute() {
+    if (pcb->isQueued()) {
+        //never launched - launch it now, in the foreground, without waiting for the jobs it depends on
+        cout << pcb->getCreatingCommand() << endl;
+        const std::vector<uint64_t> dependents = pcb->getDependents();
+        const string commandLine = smash->jobs.takeQueuedJob(jobId);
+        try {
+            smash->CreateCommand(_removeBackgroundSign(commandLine).c_str())->execute();
+        } catch (SmashExceptions::Exception &error) {
+            smash->jobs.resolveDependents(dependents, false);
+            throw;
+        }
+        smash->jobs.resolveDependents(dependents, smash->lastExitStatus == 0);
+        return;
+    }
+
     cout << *pcb << endl;
 
     ::sendSignal(*pcb, SIGCONT);
@@ -645,39 +1530,30 @@ void ForegroundCommand::execute() {
 
     //make a copy to prevent foregroundProcess from becoming a dangling pointer after job removal
     ProcessControlBlock reservePcb = ProcessControlBlock(*pcb);
+    //continued - until ctrl-Z marks it stopped again
+    reservePcb.setRunning(true);
 
     smash->setForegroundProcess(&reservePcb);
     smash->jobs.removeJobById(jobId);
-    const int waitStatus = waitpid(pid, nullptr, WUNTRACED);
-    if (waitStatus < 0) throw SmashExceptions::SyscallException("waitpid");
+    const int waitStatus = smash->jobs.waitForeground(reservePcb);
+    smash->lastExitStatus = _exitStatus(waitStatus);
     smash->setForegroundProcess(nullptr);
 
-    // ROI - loop to remove timed process in case it ended before the timeout
-    if (!(smash->jobs.timed_processes.size() < 1)) {
-
-        for (TimedProcessControlBlock &timed_pcb: smash->jobs.timed_processes) {
-            if (jobId == timed_pcb.getJobId()) {
-                smash->jobs.timed_processes.remove(timed_pcb);
-                smash->jobs.timed_processes.sort();
-                //set new signal to next item in list
-                smash->jobs.setAlarmSignal();
-            }
-        }
+    // ROI - remove timeout of the process in case it ended before the timeout
+    if (reservePcb.getProcessIds().empty()) {
+        smash->jobs.cancelTimeout(pid);
+        reservePcb.setFinished(waitStatus);
+        smash->jobs.recordFinishedJob(reservePcb);
+        smash->jobs.resolveDependents(reservePcb.getDependents(), smash->lastExitStatus == 0);
     }
 }
-    /*
-        for (auto it = smash->jobs.timed_processes.begin(); it != smash->jobs.timed_processes.end(); ++it) {
-        if (!*it) continue; //AKIVA - to prevent segmentation faults
-        if (jobId == (*it)->getJobId()) smash->jobs.timed_processes.erase(it);
-    }
-     */
 
-BackgroundCommand::BackgroundCommand(string cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {
+BackgroundCommand::BackgroundCommand(std::string_view cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {
     //sanitize inputs
     //set jobId = args[0] or lastStoppedCommand if none specified
     try {
         if (args.size() - 1 > 1) throw std::invalid_argument("Too many arguments to bg.");
-        if (args.size() - 1 == 1) jobId = stoi(args[1]);
+        if (args.size() - 1 == 1) jobId = stoi(string(args[1]));
         else jobId = smash->jobs.getLastStoppedJob()->getJobId();
     } catch (std::invalid_argument e) {
         throw SmashExceptions::InvalidArgumentsException("bg");
@@ -700,7 +1576,188 @@ void BackgroundCommand::execute() {
     smash->jobs.unpauseJob(jobId);
 }
 
-QuitCommand::QuitCommand(string cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {
+HashCommand::HashCommand(std::string_view cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {
+    if (args.size() - 1 > 1) throw SmashExceptions::TooManyArgumentsException("hash");
+    if (args.size() - 1 == 1) {
+        if (args[1] != "-r") throw SmashExceptions::InvalidArgumentsException("hash");
+        resetRequest = true;
+    }
+}
+
+void HashCommand::execute() {
+    if (resetRequest) smash->resetPathCache();
+    else smash->printPathCache();
+}
+
+LaunchCommand::LaunchCommand(std::string_view cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {
+    if (args.size() - 1 > 1) throw SmashExceptions::TooManyArgumentsException("launch");
+    if (args.size() - 1 == 1) {
+        setBackend = true;
+        if (args[1] == "fork") backend = FORK_LAUNCH;
+        else if (args[1] == "spawn") backend = SPAWN_LAUNCH;
+        else throw SmashExceptions::InvalidArgumentsException("launch");
+    }
+}
+
+void LaunchCommand::execute() {
+    if (setBackend) {
+        smash->launchBackend = backend;
+        return;
+    }
+    cout << "backend: " << ((smash->launchBackend == SPAWN_LAUNCH) ? "spawn" : "fork") << endl;
+    cout << "direct exec: " << smash->directExecCount << endl;
+    cout << "shell exec: " << smash->shellExecCount << endl;
+}
+
+TraceCommand::TraceCommand(std::string_view cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {
+    if (args.size() - 1 > 2) throw SmashExceptions::TooManyArgumentsException("trace");
+    if (args.size() - 1 == 0) return;
+    if (args[1] == "start" && args.size() - 1 == 1) action = START_TRACING;
+    else if (args[1] == "stop" && args.size() - 1 == 1) action = STOP_TRACING;
+    else if (args[1] == "dump" && args.size() - 1 == 2) {
+        action = DUMP_TRACE;
+        fileName = string(args[2]);
+    }
+    else throw SmashExceptions::InvalidArgumentsException("trace");
+}
+
+void TraceCommand::execute() {
+    switch (action) {
+        case START_TRACING:
+            Tracer::start();
+            break;
+        case STOP_TRACING:
+            Tracer::stop();
+            break;
+        case DUMP_TRACE:
+            Tracer::dump(fileName);
+            break;
+        default:
+            cout << "tracing: " << (Tracer::isEnabled() ? "on" : "off") << endl;
+    }
+}
+
+HistoryCommand::HistoryCommand(std::string_view cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {
+    if (args.size() - 1 == 0) return;
+    if (args[1] != "-s" || args.size() - 1 < 2) throw SmashExceptions::InvalidArgumentsException("history");
+    searchRequest = true;
+    //the words of the substring, as separated by single spaces
+    for (size_t argument = 2; argument < args.size(); ++argument) {
+        if (argument > 2) substring += ' ';
+        substring += args[argument];
+    }
+}
+
+void HistoryCommand::execute() {
+    if (searchRequest) smash->history.printMatches(substring, HISTORY_MAX_RECORDS);
+    else smash->history.printHistory(HISTORY_MAX_RECORDS);
+}
+
+ParallelCommand::ParallelCommand(std::string_view cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {
+    const long onlineCpus = sysconf(_SC_NPROCESSORS_ONLN);
+    workers = (onlineCpus > 0) ? onlineCpus : 1;
+
+    size_t argument = 1;
+    if (args.size() > 1 && args[1] == "-j") {
+        try {
+            if (args.size() < 3) throw std::invalid_argument("missing number of workers");
+            const int requestedWorkers = stoi(string(args[2]));
+            if (requestedWorkers <= 0) throw std::invalid_argument("no workers");
+            workers = requestedWorkers;
+        } catch (std::logic_error &e) {
+            throw SmashExceptions::InvalidArgumentsException("parallel");
+        }
+        argument = 3;
+    }
+    readInput = (argument == args.size());
+    for (; argument < args.size(); ++argument) {
+        if (args[argument].find_first_not_of(WHITESPACE) != std::string_view::npos) {
+            commandLines.emplace_back(args[argument]);
+        }
+    }
+}
+
+bool ParallelCommand::nextCommandLine(string &commandLine) {
+    if (!readInput) {
+        if (started >= commandLines.size()) return false;
+        commandLine = commandLines[started];
+        return true;
+    }
+    while (smash->readLine(commandLine)) {
+        if (commandLine.find_first_not_of(WHITESPACE) != string::npos) return true;
+    }
+    return false;
+}
+
+void ParallelCommand::start(const string &commandLine) {
+    const Running command = {++started, commandLine, monotonicMilliseconds()};
+    launching = &command;
+    launchedJob = false;
+    //run as a background job, which comes back through jobAdded
+    const bool succeeded = smash->containedExecute(smash->containedBuild(
+            _isBackgroundComamnd(commandLine) ? commandLine : commandLine + " &"));
+    launching = nullptr;
+
+    //a builtin, or a command line that failed before anything was launched
+    if (!launchedJob) report(command, succeeded ? 0 : 1);
+}
+
+void ParallelCommand::report(const Running &command, int exitStatus) {
+    if (exitStatus != 0) ++failures;
+    char elapsed[32];
+    snprintf(elapsed, sizeof(elapsed), "%.3f", (monotonicMilliseconds() - command.startTime) / 1000.0);
+    cout << "[" << command.index << "] " << command.cmd_line << " : exit status " << exitStatus << ", "
+         << elapsed << " secs" << endl;
+}
+
+void ParallelCommand::jobAdded(const ProcessControlBlock &pcb) {
+    if (!launching || pcb.isQueued()) return; //a job of after, with no process to wait for yet
+    running[pcb.getProcessId()] = *launching;
+    launchedJob = true;
+}
+
+void ParallelCommand::jobFinished(const ProcessControlBlock &pcb, int waitStatus) {
+    auto command = running.find(pcb.getProcessId());
+    if (command == running.end()) return; //not started by this command
+    report(command->second, _exitStatus(waitStatus));
+    running.erase(command);
+}
+
+void ParallelCommand::execute() {
+    if (smash->jobs.getListener()) throw SmashExceptions::Exception("parallel", "already running");
+    smash->jobs.setListener(this);
+    SmallShell::interruptSignal = 0;
+
+    try {
+        bool moreCommands = true;
+        string commandLine;
+        while (true) {
+            while (moreCommands && running.size() < workers && !SmallShell::interruptSignal) {
+                moreCommands = nextCommandLine(commandLine);
+                if (moreCommands) start(commandLine);
+            }
+            //ctrl-Z leaves the command lines that are running as ordinary jobs
+            if (running.empty() || SmallShell::interruptSignal == SIGTSTP) break;
+            //ctrl-C kills them, and they are reported as they exit
+            if (SmallShell::interruptSignal == SIGINT) {
+                SmallShell::interruptSignal = 0;
+                moreCommands = false;
+                for (const auto &command : running) killpg(command.first, SIGKILL);
+            }
+
+            smash->jobs.waitChildStateChange();
+            smash->jobs.removeFinishedJobs();
+        }
+    } catch (...) {
+        smash->jobs.setListener(nullptr);
+        throw;
+    }
+    smash->jobs.setListener(nullptr);
+
+    smash->lastExitStatus = failures ? 1 : 0;
+}
+
+QuitCommand::QuitCommand(std::string_view cmd_line, SmallShell *smash) : BuiltInCommand(cmd_line, smash) {
     if (args.size() - 1 == 1 && args[1] == "kill") killRequest = true;
 }
 
@@ -711,277 +1768,578 @@ void QuitCommand::execute() {
     exit(0);
 }
 
-BackgroundableCommand::BackgroundableCommand(string cmd_line, SmallShell *smash) :
-    Command(cmd_line, smash), backgroundRequest(_isBackgroundComamnd(cmd_line)) {}
+BackgroundableCommand::BackgroundableCommand(std::string_view cmd_line, SmallShell *smash) :
+    BackgroundableCommand(cmd_line, smash, true) {}
 
-void BackgroundableCommand::execute() {
+BackgroundableCommand::BackgroundableCommand(std::string_view cmd_line, SmallShell *smash, bool tokenize) :
+    Command(cmd_line, smash, tokenize), backgroundRequest(_isBackgroundComamnd(cmd_line)) {}
+
+pid_t BackgroundableCommand::launch() {
     //fork a son
-    pid = fork();
-    if (pid < 0) throw SmashExceptions::SyscallException("fork");
-    if (pid == 0) {
+    const uint64_t traceStart = Tracer::begin();
+    pid_t sonPid = fork();
+    if (sonPid < 0) throw SmashExceptions::SyscallException("fork");
+    if (sonPid == 0) {
         //DEBUG_PRINT("process "<<getppid()<<" forked a son for backgroundablecommand "<<cmd_line<<" with pid="<<getpid());
+        Tracer::sonStart = Tracer::begin();
+        smash->releaseSignals();
         smash->escapeSmashProcessGroup();
-
-        if (!isRedirectionBuiltinForegroundCommand) executeBackgroundable();
+        executeInSon();
         exit(0);
-    } else {
-        //if !backgroundRequest then wait for son, inform smash that a foreground program is running
-        if (!backgroundRequest) {
+    }
+    Tracer::end(TRACE_FORK, traceStart);
+    smash->escapeSmashProcessGroup(sonPid);
+    return sonPid;
+}
 
-            ProcessControlBlock foregroundPcb = ProcessControlBlock(FG_JOB_ID, pid, cmd_line);
-            smash->setForegroundProcess(&foregroundPcb);
+void BackgroundableCommand::execute() {
+    //over the limit of running jobs - the whole line is launched once a slot is free
+    if (backgroundRequest && smash->jobs.mustQueue()) {
+        smash->jobs.queueJob(string(cmd_line), string(smash->executingLine.empty() ? cmd_line : smash->executingLine));
+        return;
+    }
 
-            if (isTimeOut) {
-                //ROI - timeout handling
-                smash->jobs.addTimedProcess(foregroundPcb.getJobId(), pid, cmd_line, waitNumber);
-                smash->jobs.setAlarmSignal();
-            }
+    pid = launch();
+    if (pid < 0) return; //nothing was launched
+    if (sonPids.empty()) sonPids.push_back(pid);
 
-            int waitStatus = 0;
-            bool isHelperProcess = (getpgrp()==getppid());
-            if (!isHelperProcess) waitStatus = waitpid(pid, nullptr, WUNTRACED);
-            else waitStatus = waitpid(pid, nullptr, NO_OPTIONS);
-            if (waitStatus < 0) {
-                throw SmashExceptions::SyscallException("waitpid");
-            }
-            smash->setForegroundProcess(nullptr);
-            if (isRedirectionBuiltinForegroundCommand) executeBackgroundable(); //run from smash process
+    //if !backgroundRequest then wait for son, inform smash that a foreground program is running
+    if (!backgroundRequest) {
+
+        ProcessControlBlock foregroundPcb = ProcessControlBlock(FG_JOB_ID, pid, string(cmd_line));
+        foregroundPcb.setProcessIds(sonPids);
+        smash->setForegroundProcess(&foregroundPcb);
+
+        if (isTimeOut) {
+            //ROI - timeout handling
+            smash->jobs.addTimedProcess(foregroundPcb.getJobId(), pid, foregroundPcb.getCreatingCommand(),
+                                        timeoutMilliseconds);
+            smash->jobs.armTimeoutTimer();
         }
-        //else add to jobs
-        else {
-            smash->jobs.addJob(*this, pid);
-            // ROI - timeout handling
-            if (isTimeOut) {
-                smash->jobs.addTimedProcess(smash->jobs.getLastJob()->getJobId(), pid, cmd_line, waitNumber, true);
-                smash->jobs.setAlarmSignal();
-            }
+
+        smash->lastExitStatus = _exitStatus(smash->jobs.waitForeground(foregroundPcb));
+        smash->setForegroundProcess(nullptr);
+        //a stopped job keeps its timeout
+        if (isTimeOut && foregroundPcb.getProcessIds().empty()) smash->jobs.cancelTimeout(pid);
+    }
+    //else add to jobs
+    else {
+        // ROI - timeout handling, set before the job is added so it is cancelled if the job is already done
+        if (isTimeOut) {
+            smash->jobs.addTimedProcess(UNINITIALIZED_JOB_ID, pid, string(cmd_line), timeoutMilliseconds, true);
+            smash->jobs.armTimeoutTimer();
         }
+        smash->jobs.addJob(*this, sonPids);
     }
 }
 
+void BackgroundableCommand::executeInSon() {
+    applyOutputRedirection();
+    executeBackgroundable();
+}
 
-PipeCommand::PipeCommand(std::string cmd_line, SmallShell *smash) : BackgroundableCommand(cmd_line, smash) {
-    unsigned int pipeIndex = cmd_line.find_first_of('|');
-    //sanitize inputs
-    if (!(cmd_line.size() > pipeIndex + 1)) throw SmashExceptions::InvalidArgumentsException("pipe");
-
-    //check what sort of pipe this is (stdout or stderr channel)
-    if (cmd_line[pipeIndex + 1] == '&') errPipe = true;
+void BackgroundableCommand::setBackgroundRequest(bool backgroundRequest) {
+    BackgroundableCommand::backgroundRequest = backgroundRequest;
+}
 
-    //split up command into commandFrom (sending output) and commandTo (input receiver) sections
-    cmd_lineFrom = _removeBackgroundSign(cmd_line.substr(0, pipeIndex));
-    cmd_lineTo = _removeBackgroundSign(cmd_line.substr(pipeIndex + 1 + (errPipe ? 1 : 0)));
+void BackgroundableCommand::setOutputRedirection(const string &fileName, bool append) {
+    outputFile = fileName;
+    appendOutput = append;
+}
 
-    //create pipe to channel output from commandFrom into commandTo
-    if (pipe(pipeSides)<0) throw SmashExceptions::SyscallException("pipe");
+void BackgroundableCommand::applyOutputRedirection() {
+    if (outputFile.empty()) return;
+    TraceScope trace(TRACE_REDIRECTION);
+    int fd = _openOutputFile(outputFile, appendOutput);
+    if (dup2(fd, STDOUT_FILENO) < 0) throw SmashExceptions::SyscallException("dup2");
+    if (close(fd) < 0) throw SmashExceptions::SyscallException("close");
 }
 
+PipeCommand::PipeCommand(std::string_view cmd_line, SmallShell *smash) : BackgroundableCommand(cmd_line, smash, false) {
+    //c_str drops what follows the terminator left by the sign removal
+    const string line = _removeBackgroundSign(cmd_line).c_str();
 
-PipeCommand::PipeCommand(std::unique_ptr<Command> commandFrom, std::unique_ptr<Command> commandTo, SmallShell *smash) :
-        BackgroundableCommand(string(), smash), commandFrom(std::move(commandFrom)),
-        commandTo(std::move(commandTo)) {
+    //split up command into stages, each feeding the next through a pipe
+    size_t stageStart = 0;
+    while (true) {
+        size_t pipeIndex = _findUnquoted(line, '|', stageStart);
+        Stage stage = {line.substr(stageStart, pipeIndex - stageStart), false};
+        //check what sort of pipe this is (stdout or stderr channel)
+        if (pipeIndex != string::npos && pipeIndex + 1 < line.size() && line[pipeIndex + 1] == '&') stage.errPipe = true;
 
-    //create pipe
-    if (pipe(pipeSides)<0) throw SmashExceptions::SyscallException("pipe");
-}
+        //sanitize inputs
+        if (_trim(stage.cmd_line).empty()) throw SmashExceptions::InvalidArgumentsException("pipe");
+        stages.push_back(stage);
 
-void PipeCommand::commandFromNonBuiltinExecution() {
-    //run commandFrom fork
-    if ((pidFrom = fork()) < 0) throw SmashExceptions::SyscallException("fork");
-    if (!pidFrom) {
-        *processGroupFromPtr = smash->escapeSmashProcessGroup();
-        if (signal(SIGCONT, SIG_DFL) == SIG_ERR) throw SmashExceptions::SyscallException("signal");
-        //DEBUG_PRINT("process "<<getppid()<<" forked a son for pipe commandFrom "<<commandFrom->cmd_line<<" with pid="<<getpid());
-        //close pipe read side
-        if (close(pipeSides[0])) throw SmashExceptions::SyscallException("close");
-        //replace stdout with pipe write side
-        if (dup2(pipeSides[1], errPipe ? STDERR_FILENO : STDOUT_FILENO) < 0)
-            throw SmashExceptions::SyscallException("dup2");
-        //build and execute commandFrom
-        if (!commandFrom) commandFrom = smash->containedBuild(cmd_lineFrom);
-        smash->containedExecute(commandFrom);
-        exit(0);
+        if (pipeIndex == string::npos) break;
+        stageStart = pipeIndex + 1 + indicator(stage.errPipe);
     }
 }
 
-void PipeCommand::commandFromBuiltinExecution() {
-    typedef int fd_number_t;
-    fd_number_t outputAddress = errPipe ? STDERR_FILENO : STDOUT_FILENO;
+pid_t PipeCommand::launch() {
+    //create all pipes up front - pipe i connects stage i to stage i+1
+    StageSetup setup;
+    for (size_t i = 0; i + 1 < stages.size(); ++i) {
+        int pipeSides[2];
+        if (pipe2(pipeSides, O_CLOEXEC) < 0) {
+            for (int fd : setup.pipeFds) close(fd);
+            throw SmashExceptions::SyscallException("pipe");
+        }
+        setup.pipeFds.push_back(pipeSides[0]);
+        setup.pipeFds.push_back(pipeSides[1]);
+    }
 
-    //duplicate stdout/stderr
-    fd_number_t stdoutCopy = dup(outputAddress);
+    //stages of a pipeline launched by smash share a new process group, led by the first stage
+    const bool ownProcessGroup = smash->inSmashProcessGroup();
+    pid_t processGroup = ownProcessGroup ? 0 : -1;
+    sonPids.clear();
+    try {
+        for (size_t i = 0; i < stages.size(); ++i) {
+            setup.inputFd = (i > 0) ? setup.pipeFds[2 * (i - 1)] : -1;
+            setup.outputFd = (i + 1 < stages.size()) ? setup.pipeFds[2 * i + 1] : -1;
+            setup.outputChannel = stages[i].errPipe ? STDERR_FILENO : STDOUT_FILENO;
+            setup.processGroup = processGroup;
+
+            //build commands in smash, so that external stages may be spawned
+            unique_ptr<Command> stageCommand = smash->containedBuild(stages[i].cmd_line);
+            if (!stageCommand) continue; //neighbours see the closed pipe ends
+
+            pid_t sonPid;
+            ExternalCommand *external = dynamic_cast<ExternalCommand *>(stageCommand.get());
+            if (external) external->prepareLaunch();
+            if (external && smash->launchBackend == SPAWN_LAUNCH) sonPid = external->spawn(setup);
+            else sonPid = forkStage(stageCommand, setup);
+
+            if (ownProcessGroup) {
+                //parent side of joining the group, see escapeSmashProcessGroup
+                setpgid(sonPid, processGroup ? processGroup : sonPid);
+                if (!processGroup) processGroup = sonPid;
+            }
+            sonPids.push_back(sonPid);
+        }
+    } catch (SmashExceptions::Exception &error) {
+        for (int fd : setup.pipeFds) close(fd);
+        if (!sonPids.empty()) killpg(processGroup > 0 ? processGroup : getpgrp(), SIGKILL);
+        throw;
+    }
 
-    //replace stdout/err with pipe write side
-    if (dup2(pipeSides[1], outputAddress) < 0)
-        throw SmashExceptions::SyscallException("dup2");
+    for (int fd : setup.pipeFds) {
+        if (close(fd) < 0) throw SmashExceptions::SyscallException("close");
+    }
+    return sonPids.empty() ? -1 : sonPids.front();
+}
+
+/// stdout of a builtin pipe stage, in place of cout's own buffer while it exists. Builtins end every line with endl,
+/// which would make each line a write of its own; here line flushes are ignored, and the output reaches the pipe in
+/// writes of PIPE_STAGE_BUFFER_SIZE bytes, plus one for the rest when the stage is done
+class PipeStageOutput : public std::streambuf {
+private:
+    char buffer[PIPE_STAGE_BUFFER_SIZE];
+    std::streambuf *previousBuffer;
+
+    /// \return false if the pipe can't be written to any more
+    bool drain() {
+        for (const char *next = pbase(); next < pptr();) {
+            const ssize_t written = write(STDOUT_FILENO, next, pptr() - next);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            next += written;
+        }
+        setp(buffer, buffer + sizeof(buffer));
+        return true;
+    }
 
-    //build and execute commandFrom
-    if (!commandFrom) commandFrom = smash->containedBuild(cmd_lineFrom);
-    smash->containedExecute(commandFrom);
-
-    //restore stdout/err
-    if (dup2(stdoutCopy, outputAddress)<0) throw SmashExceptions::SyscallException("dup2");
-    //close duplicate
-    if (close(stdoutCopy)<0) throw SmashExceptions::SyscallException("close");
-
-    //run commandFrom fork (pointless, for structure)
-    if ((pidFrom = fork()) < 0) throw SmashExceptions::SyscallException("fork");
-    if (!pidFrom){
-        //DEBUG_PRINT("CommandFrom pointlessly started, exiting");
-        //close pipe read side
-        if (close(pipeSides[0])) throw SmashExceptions::SyscallException("close");
-        exit(0);
+protected:
+    int_type overflow(int_type character) override {
+        if (!drain()) return traits_type::eof();
+        if (!traits_type::eq_int_type(character, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(character);
+            pbump(1);
+        }
+        return traits_type::not_eof(character);
     }
-}
 
-void PipeCommand::commandFromExecution() {
-    if (!isRedirectionBuiltinForegroundCommand) commandFromNonBuiltinExecution();
-    else commandFromBuiltinExecution();
-}
+    int sync() override {
+        return 0;
+    }
 
-void PipeCommand::commandToExecution() {
-    //run commandTo fork
-    if ((pidTo = fork()) < 0) throw SmashExceptions::SyscallException("fork");
-    if (!pidTo) {
-        *processGroupToPtr = smash->escapeSmashProcessGroup();
-        if (signal(SIGCONT, SIG_DFL) == SIG_ERR) throw SmashExceptions::SyscallException("signal");
-        //DEBUG_PRINT("process "<<getppid()<<" forked a son for pipe commandTo "<<commandTo->cmd_line<<" with pid="<<getpid());
-        //close pipe write side
-        if (close(pipeSides[1])) throw SmashExceptions::SyscallException("close");
-        //replace stdin with pipe read side
-        if (dup2(pipeSides[0], STDIN_FILENO) < 0) throw SmashExceptions::SyscallException("dup2");
-        //build and execute commandTo
-        if (!commandTo) commandTo = smash->containedBuild(cmd_lineTo);
-        smash->containedExecute(commandTo);
-        exit(0);
+public:
+    PipeStageOutput() : previousBuffer(cout.rdbuf(this)) {
+        setp(buffer, buffer + sizeof(buffer));
     }
-}
 
-void PipeCommand::executeBackgroundable() {
-    //create pipe
-    if (pipe(pipeSides)) throw SmashExceptions::SyscallException("pipe");
-
-    PipeCommand::commandFromExecution();
-    if (pidFrom) {
-        commandToExecution();
-        if (pidTo){
-            //parent
-            if (close(pipeSides[0]) || close(pipeSides[1])) throw SmashExceptions::SyscallException("close");
-
-            //wait for commandTo fork and for commandFrom fork to finish
-            if (waitpid(pidFrom, nullptr, NO_OPTIONS)<0) throw SmashExceptions::SyscallException("wait");
-            //DEBUG_PRINT("Finished waiting for commandFrom.  Sending signal to it at "<<pidFrom<<((kill(pidFrom, 0)<0)? " failed, as it should":" succeeded (uh oh)"));
-            if (waitpid(pidTo,nullptr, NO_OPTIONS)<0) throw SmashExceptions::SyscallException("wait");
-            //DEBUG_PRINT("Finished waiting for commandTo.  Sending signal to it at "<<pidTo<<((kill(pidTo, 0)<0)? " failed, as it should":" succeeded (uh oh)"));
-
-            pidFrom = pidTo = -1;
+    ~PipeStageOutput() override {
+        drain();
+        cout.rdbuf(previousBuffer);
+    }
+};
+
+pid_t PipeCommand::forkStage(const unique_ptr<Command> &stageCommand, const StageSetup &setup) {
+    const uint64_t traceStart = Tracer::begin();
+    pid_t sonPid = fork();
+    if (sonPid < 0) throw SmashExceptions::SyscallException("fork");
+    if (sonPid == 0) {
+        //DEBUG_PRINT("process "<<getppid()<<" forked a son for pipe stage "<<stageCommand->cmd_line<<" with pid="<<getpid());
+        Tracer::sonStart = Tracer::begin();
+        smash->releaseSignals();
+        applyStageSetup(setup);
+        if (setup.outputFd >= 0 && setup.outputChannel == STDOUT_FILENO &&
+            dynamic_cast<BuiltInCommand *>(stageCommand.get())) {
+            //static, so that it is flushed by exit, also when the builtin exits by itself (quit)
+            static PipeStageOutput stageOutput;
         }
+        smash->containedExecute(stageCommand, true);
+        exit(0);
     }
+    Tracer::end(TRACE_FORK, traceStart);
+    return sonPid;
 }
 
-
-PipeCommand::~PipeCommand() {
-    if (pidFrom != -1) {
-        DEBUG_PRINT("sending SIGKILL to commandFrom");
-        if (killpg(processGroupFrom, SIGKILL) < 0) {
-            DEBUG_PRINT("pipe command: pidFrom = " << pidFrom << " and kill failed with errno = " << errno);
-            perror("killpg failed");
-        }
+void PipeCommand::applyStageSetup(const StageSetup &setup) {
+    TraceScope trace(TRACE_REDIRECTION);
+    if (setup.processGroup >= 0 && setpgid(0, setup.processGroup) < 0) {
+        throw SmashExceptions::SyscallException("setpgid");
     }
-    if (pidTo != -1) {
-        DEBUG_PRINT("sending SIGKILL to commandTo");
-        if (killpg(processGroupTo, SIGKILL) < 0) {
-            DEBUG_PRINT("pipe command: pidTo = " << pidFrom << " and kill failed with errno = " << errno);
-            perror("killpg failed");
-        }
+    //replace stdin with read side of previous pipe, stdout/err with write side of next pipe
+    if (setup.inputFd >= 0 && dup2(setup.inputFd, STDIN_FILENO) < 0) throw SmashExceptions::SyscallException("dup2");
+    if (setup.outputFd >= 0 && dup2(setup.outputFd, setup.outputChannel) < 0) {
+        throw SmashExceptions::SyscallException("dup2");
+    }
+    for (int fd : setup.pipeFds) {
+        if (close(fd) < 0) throw SmashExceptions::SyscallException("close");
     }
 }
 
-RedirectionCommand::RedirectionCommand(unique_ptr<Command> commandFrom, string filename, bool append, SmallShell *smash) :
-        PipeCommand(std::move(commandFrom),
-                std::move(unique_ptr<Command>(new WriteCommand(filename, append, smash))), smash) {}
+void PipeCommand::executeBackgroundable() {
+    //already inside a son - run the stages as its sons and wait for all of them
+    pid_t leader = launch();
+    if (leader < 0) return;
+    TraceScope trace(TRACE_WAIT);
+    for (pid_t stagePid : sonPids) {
+        if (smash->jobs.waitChild(stagePid, nullptr, NO_OPTIONS) < 0) throw SmashExceptions::SyscallException("wait");
+    }
+}
 
+RedirectionCommand::RedirectionCommand(std::string_view cmd_line, size_t operatorPosition, SmallShell *smash) :
+        Command(cmd_line, smash, false),
+        innerCommand(smash->CreateCommand(cmd_line.substr(0, operatorPosition))),
+        targetFile(_redirectionTarget(cmd_line, operatorPosition)),
+        append(cmd_line.substr(operatorPosition + 1, 1) == ">") {
 
-RedirectionCommand::RedirectionCommand(std::string cmd_line, int operatorPosition, SmallShell *smash) :
-        RedirectionCommand(std::move(smash->CreateCommand(cmd_line.substr(0, operatorPosition))),
-            _trim(_removeBackgroundSign(cmd_line).substr(operatorPosition + 1
-                + indicator(cmd_line.at(1 + operatorPosition) == '>'))),
-            cmd_line.at(1 + operatorPosition) == '>',
-            smash) {
+    //jobs list should show the whole command line
+    innerCommand->cmd_line = cmd_line;
+}
 
-    this->cmd_line = cmd_line;
-    backgroundRequest = _isBackgroundComamnd(cmd_line);
-    //args not set, but may be with the following command
-    //args = initArgs(cmd_line);
+void RedirectionCommand::execute() {
+    BackgroundableCommand *backgroundable = dynamic_cast<BackgroundableCommand *>(innerCommand.get());
+    if (!backgroundable) {
+        executeInPlace();
+        return;
+    }
+
+    //son opens the file and writes into it directly
+    backgroundable->setBackgroundRequest(_isBackgroundComamnd(cmd_line));
+    backgroundable->setOutputRedirection(targetFile, append);
+    backgroundable->execute();
 }
 
+void RedirectionCommand::executeInSon() {
+    BackgroundableCommand *backgroundable = dynamic_cast<BackgroundableCommand *>(innerCommand.get());
+    if (!backgroundable) {
+        executeInPlace();
+        return;
+    }
+    backgroundable->setOutputRedirection(targetFile, append);
+    backgroundable->executeInSon();
+}
 
-void RedirectionCommand::execute() {
-    isRedirectionBuiltinForegroundCommand = commandFrom->isBuiltIn && !BackgroundableCommand::backgroundRequest;
-    PipeCommand::execute();
+void RedirectionCommand::executeInPlace() {
+    const uint64_t traceStart = Tracer::begin();
+    int fd = _openOutputFile(targetFile, append);
+    cout.flush();
+    int stdoutCopy = dup(STDOUT_FILENO);
+    if (stdoutCopy < 0 || dup2(fd, STDOUT_FILENO) < 0) {
+        close(fd);
+        if (stdoutCopy >= 0) close(stdoutCopy);
+        throw SmashExceptions::SyscallException(stdoutCopy < 0 ? "dup" : "dup2");
+    }
+    if (close(fd) < 0) throw SmashExceptions::SyscallException("close");
+    Tracer::end(TRACE_REDIRECTION, traceStart);
+
+    try {
+        innerCommand->execute();
+    } catch (SmashExceptions::Exception& error) {
+        cout.flush();
+        dup2(stdoutCopy, STDOUT_FILENO);
+        close(stdoutCopy);
+        throw;
+    }
+
+    //restore stdout
+    cout.flush();
+    if (dup2(stdoutCopy, STDOUT_FILENO) < 0) throw SmashExceptions::SyscallException("dup2");
+    if (close(stdoutCopy) < 0) throw SmashExceptions::SyscallException("close");
 }
 
-void RedirectionCommand::createEmptyFile(const string& cmd_line) {
-    int operatorPosition = (cmd_line.find_first_of('>'));
-    string pathName = _trim(_removeBackgroundSign(cmd_line).substr(operatorPosition + 1
-            + indicator(cmd_line.at(1 + operatorPosition) == '>')));
+void RedirectionCommand::createEmptyFile(std::string_view cmd_line, size_t operatorPosition) {
+    TraceScope trace(TRACE_REDIRECTION);
+    string pathName = _redirectionTarget(cmd_line, operatorPosition);
 
     int placeholderFile = open(pathName.c_str(), O_CREAT|O_WRONLY, S_IRWXU|S_IRWXG|S_IRWXO);
     if (placeholderFile < 0) throw SmashExceptions::SyscallException("open");
     if (close(placeholderFile) < 0) throw SmashExceptions::SyscallException("close");
 }
 
-RedirectionCommand::WriteCommand::WriteCommand(string fileName, bool append, SmallShell *smash) :
-        Command("write_into " + fileName, smash) {
+CopyCommand::CopyCommand(std::string_view cmd_line, SmallShell *smash) : BackgroundableCommand(cmd_line, smash) {
+    //cp [-j workers] [--verify] <source> <target>
+    size_t argument = 1;
+    for (; argument < args.size(); ++argument) {
+        if (args[argument] == "--verify") verify = true;
+        else if (args[argument] == "-j") {
+            try {
+                if (argument + 1 >= args.size()) throw std::invalid_argument("missing number of workers");
+                const int requestedWorkers = stoi(string(args[++argument]));
+                if (requestedWorkers <= 0) throw std::invalid_argument("no workers");
+                workers = requestedWorkers;
+            } catch (std::logic_error &e) {
+                throw SmashExceptions::InvalidArgumentsException("cp");
+            }
+        }
+        else break;
+    }
+    if (args.size() - argument < 2) throw SmashExceptions::InvalidArgumentsException("cp");
+    sourceFile = args[argument];
+    targetFile = args[argument + 1];
+
+    const string closingMessage = "smash: " + sourceFile + " was copied to " + targetFile;
+    if (isSameFile(sourceFile, targetFile)) throw SmashExceptions::SameFileException(closingMessage);
+}
+
+void CopyCommand::executeBackgroundable() {
+    int sourceFd = open(sourceFile.c_str(), O_RDONLY);
+    if (sourceFd < 0) throw SmashExceptions::SyscallException("open");
+    //the copy is read back to verify it
+    int targetFd = open(targetFile.c_str(), (verify ? O_RDWR : O_WRONLY) | O_CREAT | O_TRUNC, 0666);
+    if (targetFd < 0) {
+        close(sourceFd);
+        throw SmashExceptions::SyscallException("open");
+    }
 
-    sink.open(fileName, append ? std::ofstream::app : std::ofstream::trunc);
-    if (sink.failbit & sink.rdstate()) throw SmashExceptions::SyscallException("open");
+    const std::chrono::steady_clock::time_point copyStart = std::chrono::steady_clock::now();
+    std::chrono::duration<double> copyTime(0), verifyTime(0);
+    off_t copied = 0;
+    try {
+        struct stat sourceStat;
+        if (fstat(sourceFd, &sourceStat) < 0) throw SmashExceptions::SyscallException("fstat");
+        //only a regular file has ranges to split, and can be read again to verify the copy
+        const bool regularSource = S_ISREG(sourceStat.st_mode);
+        if (verify && !regularSource) throw SmashExceptions::Exception("cp", "--verify needs a regular source file");
+
+        if (workers && regularSource) {
+            copied = sourceStat.st_size;
+            copyRanges(sourceFd, targetFd, copied, workers);
+        } else copied = copyContents(sourceFd, targetFd);
+        copyTime = std::chrono::steady_clock::now() - copyStart;
+
+        if (verify) {
+            if (!verifyRanges(sourceFd, targetFd, copied, std::max(workers, 1u))) {
+                throw SmashExceptions::Exception("cp", targetFile + " differs from " + sourceFile);
+            }
+            verifyTime = std::chrono::steady_clock::now() - copyStart - copyTime;
+        }
+    } catch (SmashExceptions::Exception& error) {
+        close(sourceFd);
+        close(targetFd);
+        throw;
+    }
+    if (close(sourceFd) < 0 || close(targetFd) < 0) throw SmashExceptions::SyscallException("close");
+
+    cout << "smash: " << sourceFile << " was copied to " << targetFile << endl;
+    if (workers || verify) {
+        const double megabytes = copied / (1024.0 * 1024.0);
+        char report[160];
+        snprintf(report, sizeof(report), "smash: %.1f MB in %.3f secs, %.1f MB/s", megabytes, copyTime.count(),
+                 copyTime.count() > 0 ? megabytes / copyTime.count() : 0.0);
+        cout << report;
+        if (verify) {
+            snprintf(report, sizeof(report), ", crc32c verified in %.3f secs", verifyTime.count());
+            cout << report;
+        }
+        cout << endl;
+    }
 }
 
-void RedirectionCommand::WriteCommand::execute() {
-    char buf;
-    int readStatus;
-    while ((readStatus = read(STDIN_FILENO, &buf, 1)) > 0) {
-        sink.write(&buf, 1);
-        sink.flush();
+/// run work on every range of the first size bytes of a file, from workers threads at once, until every range is
+/// done or one of them failed
+/// \param work gets the offset and length of a range, and returns 0 on success
+/// \return what work returned for the first range that failed, 0 if none did
+int _forEachRange(off_t size, unsigned workers, const std::function<int(off_t, off_t)> &work) {
+    std::atomic<off_t> nextRange(0);
+    std::atomic<int> failure(0);
+    auto worker = [&]() {
+        while (!failure.load(std::memory_order_relaxed)) {
+            const off_t start = nextRange.fetch_add(COPY_RANGE_SIZE);
+            if (start >= size) return;
+            const int result = work(start, std::min(COPY_RANGE_SIZE, size - start));
+            int noFailure = 0;
+            if (result) failure.compare_exchange_strong(noFailure, result);
+        }
+    };
+
+    //no more threads than ranges, and this thread is one of them
+    const off_t ranges = (size + COPY_RANGE_SIZE - 1) / COPY_RANGE_SIZE;
+    std::vector<std::thread> threads;
+    for (off_t thread = 1; thread < std::min<off_t>(workers, ranges); ++thread) {
+        try {
+            threads.emplace_back(worker);
+        } catch (std::system_error &error) {
+            break; //out of threads - the ones running do the rest
+        }
+    }
+    worker();
+    for (std::thread &thread : threads) thread.join();
+    return failure;
+}
+
+/// copy a range of one file to the same offset of another, inside the kernel where possible
+/// \return 0 on success, errno on failure
+int _copyRange(int sourceFd, int targetFd, off_t start, off_t length) {
+    off_t sourceOffset = start, targetOffset = start;
+    const off_t end = start + length;
+    bool inKernel = true;
+    while (inKernel && sourceOffset < end) {
+        const ssize_t result = copy_file_range(sourceFd, &sourceOffset, targetFd, &targetOffset, end - sourceOffset, 0);
+        if (result > 0) continue;
+        if (result == 0) return 0; //the source shrank meanwhile
+        if (errno == EINTR) continue;
+        //unsupported for these files - fall back to pread/pwrite
+        if (sourceOffset == start && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)) {
+            inKernel = false;
+        } else return errno;
     }
-    cout<<closingMessage;
-}
 
-RedirectionCommand::WriteCommand::~WriteCommand() {
-    sink.close();
+    std::vector<char> buffer(inKernel ? 0 : COPY_BUFFER_SIZE);
+    while (sourceOffset < end) {
+        const ssize_t readCount = pread(sourceFd, buffer.data(), std::min<off_t>(buffer.size(), end - sourceOffset),
+                                        sourceOffset);
+        if (readCount == 0) return 0;
+        if (readCount < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        for (ssize_t written = 0; written < readCount;) {
+            const ssize_t writeCount = pwrite(targetFd, buffer.data() + written, readCount - written,
+                                              sourceOffset + written);
+            if (writeCount < 0) {
+                if (errno == EINTR) continue;
+                return errno;
+            }
+            written += writeCount;
+        }
+        sourceOffset += readCount;
+    }
+    return 0;
+}
+
+/// CRC-32C of a range of a file
+/// \param buffer where to read the range into, a part at a time
+/// \return 0 on success, errno on failure
+int _checksumRange(int fd, off_t start, off_t length, std::vector<char> &buffer, uint32_t &crc) {
+    crc = 0;
+    for (off_t offset = start; offset < start + length;) {
+        const ssize_t readCount = pread(fd, buffer.data(), std::min<off_t>(buffer.size(), start + length - offset),
+                                        offset);
+        if (readCount == 0) return 0;
+        if (readCount < 0) {
+            if (errno == EINTR) continue;
+            return errno;
+        }
+        crc = crc32c(crc, buffer.data(), readCount);
+        offset += readCount;
+    }
+    return 0;
+}
+
+void CopyCommand::copyRanges(int sourceFd, int targetFd, off_t size, unsigned workers) {
+    //the whole size up front, so that ranges may be written in any order
+    if (ftruncate(targetFd, size) < 0) throw SmashExceptions::SyscallException("ftruncate");
+    const int error = _forEachRange(size, workers, [sourceFd, targetFd](off_t start, off_t length) {
+        return _copyRange(sourceFd, targetFd, start, length);
+    });
+    if (error) {
+        errno = error;
+        throw SmashExceptions::SyscallException("copy_file_range");
+    }
 }
 
-void RedirectionCommand::WriteCommand::setClosingMessage(const string &closingMessage) {
-    WriteCommand::closingMessage = closingMessage;
+bool CopyCommand::verifyRanges(int sourceFd, int targetFd, off_t size, unsigned workers) {
+    const int error = _forEachRange(size, workers, [sourceFd, targetFd](off_t start, off_t length) {
+        std::vector<char> buffer(COPY_BUFFER_SIZE);
+        uint32_t sourceCrc, targetCrc;
+        int result = _checksumRange(sourceFd, start, length, buffer, sourceCrc);
+        if (!result) result = _checksumRange(targetFd, start, length, buffer, targetCrc);
+        if (!result && sourceCrc != targetCrc) result = CHECKSUM_MISMATCH;
+        return result;
+    });
+    if (error == CHECKSUM_MISMATCH) return false;
+    if (error) {
+        errno = error;
+        throw SmashExceptions::SyscallException("pread");
+    }
+    return true;
 }
 
-CopyCommand::CopyCommand(string cmd_line, SmallShell *smash) try :
-        RedirectionCommand(
-                unique_ptr<Command>(
-                        duplicityCheck(new ReadCommand(getSourceFile((initArgs(cmd_line))), smash), initArgs(cmd_line))),
-                getTargetFile(initArgs(cmd_line)),
-                false,
-                smash) {
-
-    this->cmd_line = cmd_line;
-    args = initArgs(cmd_line);
-    backgroundRequest = _isBackgroundComamnd(cmd_line);
-    dynamic_cast<RedirectionCommand::WriteCommand*>(commandTo.get())->
-        setClosingMessage("smash: "+args.at(1)+" was copied to "+args.at(2)+"\n");
-} catch (std::out_of_range& e) {
-    throw SmashExceptions::InvalidArgumentsException("cp");
-}
+off_t CopyCommand::copyContents(int sourceFd, int targetFd) {
+    off_t copied = 0;
 
+    //copy_file_range - no data leaves the kernel, and filesystems may share or offload the extents
+    while (true) {
+        ssize_t result = copy_file_range(sourceFd, nullptr, targetFd, nullptr, COPY_CHUNK_SIZE, 0);
+        if (result > 0) {
+            copied += result;
+            continue;
+        }
+        if (result == 0) return copied;
+        if (errno == EINTR) continue;
+        //unsupported for these files (only possible before anything was copied) - fall back to sendfile
+        if (copied == 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS || errno == EOPNOTSUPP)) break;
+        throw SmashExceptions::SyscallException("copy_file_range");
+    }
 
-void CopyCommand::execute() {
-    RedirectionCommand::execute();
-}
+    //sendfile - still no copy through user space
+    while (true) {
+        ssize_t result = sendfile(targetFd, sourceFd, nullptr, COPY_CHUNK_SIZE);
+        if (result > 0) {
+            copied += result;
+            continue;
+        }
+        if (result == 0) return copied;
+        if (errno == EINTR) continue;
+        if (copied == 0 && (errno == EINVAL || errno == ENOSYS)) break;
+        throw SmashExceptions::SyscallException("sendfile");
+    }
 
-CopyCommand::ReadCommand* CopyCommand::duplicityCheck(ReadCommand* passAlong, const std::vector<std::string> &args){
-    const string closingMessage = "smash: " + args.at(1) + " was copied to " + args.at(2) + "\n";
-    if (isSameFile(args.at(1), args.at(2))) throw SmashExceptions::SameFileException(closingMessage);
-    return passAlong;
+    //plain read/write with a large buffer
+    std::vector<char> buffer(COPY_BUFFER_SIZE);
+    while (true) {
+        ssize_t readCount = read(sourceFd, buffer.data(), buffer.size());
+        if (readCount == 0) return copied;
+        if (readCount < 0) {
+            if (errno == EINTR) continue;
+            throw SmashExceptions::SyscallException("read");
+        }
+        for (ssize_t written = 0; written < readCount;) {
+            ssize_t writeCount = write(targetFd, buffer.data() + written, readCount - written);
+            if (writeCount < 0) {
+                if (errno == EINTR) continue;
+                throw SmashExceptions::SyscallException("write");
+            }
+            written += writeCount;
+        }
+        copied += readCount;
+    }
 }
 
 bool CopyCommand::isSameFile(string fileFrom, string fileTo) {
@@ -993,73 +2351,48 @@ bool CopyCommand::isSameFile(string fileFrom, string fileTo) {
         throw SmashExceptions::SyscallException("malloc");
     }
 
-    if (!(realpath(fileFrom.c_str(), fullPathFrom) && realpath(fileTo.c_str(), fullPathTo))){
+    if (!realpath(fileFrom.c_str(), fullPathFrom)){
         free(fullPathFrom);
         free(fullPathTo);
         throw SmashExceptions::SyscallException("realpath");
     }
+    if (!realpath(fileTo.c_str(), fullPathTo)){
+        free(fullPathFrom);
+        free(fullPathTo);
+        //target doesn't exist yet, so it can't be the source
+        if (errno == ENOENT) return false;
+        throw SmashExceptions::SyscallException("realpath");
+    }
     bool notResult = strcmp(fullPathFrom, fullPathTo);
     free(fullPathFrom);
     free(fullPathTo);
     return !notResult;
 }
 
-string CopyCommand::getTargetFile(std::vector<std::string> args) {
-    return args.at(2);
-}
-
-string CopyCommand::getSourceFile(std::vector<std::string> args) {
-    if (args.size()-1 < 2) throw SmashExceptions::InvalidArgumentsException("cp");
-    return args.at(1);
-}
-
-
-CopyCommand::ReadCommand::ReadCommand(string fileName, SmallShell *smash) :
-        Command("read_from " + fileName, smash) {
-
-    source.open(fileName);
-    if (source.failbit & source.rdstate()) throw SmashExceptions::SyscallException("open");
-}
-
-
-void CopyCommand::ReadCommand::execute() {
-    for (char nextLetter = source.get(); source.good() && nextLetter != EOF; nextLetter = source.get()) {
-        cout << nextLetter;
-    }
-    cout.flush();
-}
-
-CopyCommand::ReadCommand::~ReadCommand() {
-    source.close();
-}
 // ROI - timeout command
 
 // to check - do we need to handle a scenario (error) where the inner command is a built-in command ??
-TimeoutCommand::TimeoutCommand(string cmd_line, SmallShell *smash) : Command(cmd_line, smash),
+TimeoutCommand::TimeoutCommand(std::string_view cmd_line, SmallShell *smash) : Command(cmd_line, smash),
                                                                      backgroundRequest(_isBackgroundComamnd(cmd_line)) {
-    // trimming 1st word, saving number and saving the rest of the command
-    string trimmed_cmd = _trim(cmd_line);
-    unsigned short timeout_index = trimmed_cmd.find_first_of("timeout");
-    if (timeout_index != 0) throw SmashExceptions::InvalidArgumentsException("timeout");
-    string no_timeout_cmd = trimmed_cmd.substr(7, trimmed_cmd.length() + 1);
-    //string trimmed_no_timeout_cmd = _trim(no_timeout_cmd);
-    unsigned short digits_index = _trim(no_timeout_cmd).find_first_of(DIGITS);
-    if (digits_index != 0) throw SmashExceptions::InvalidArgumentsException("timeout");
-    unsigned short digits_end_index = _trim(no_timeout_cmd).find_first_of(' ');
-    if (digits_end_index > 100) throw SmashExceptions::InvalidArgumentsException("timeout");
-    string str_number = _trim(no_timeout_cmd).substr(digits_index, digits_end_index);
-    if (str_number.find_first_not_of(DIGITS) != std::string::npos)
+    // timeout <duration> <command>, duration in seconds with an optional fraction (e.g. timeout 0.25 sleep 1)
+    if (args.size() - 1 < 2) throw SmashExceptions::InvalidArgumentsException("timeout");
+    try {
+        timeoutMilliseconds = _secondsToMilliseconds(string(args[1]));
+    } catch (std::invalid_argument& e) {
         throw SmashExceptions::InvalidArgumentsException("timeout");
-    inner_cmd_line = trimmed_cmd.substr(trimmed_cmd.find_first_of(str_number) + str_number.length() + 1,
-                                        trimmed_cmd.length() + 1);
+    }
+    if (timeoutMilliseconds == 0) throw SmashExceptions::InvalidArgumentsException("timeout");
+
+    // the rest of the line after the duration is the command
+    string trimmed_cmd = _trim(string(cmd_line));
+    size_t duration_index = trimmed_cmd.find(args[1], args[0].length());
+    inner_cmd_line = _trim(trimmed_cmd.substr(duration_index + args[1].length()));
 
     innerCommand = smash->CreateCommand(inner_cmd_line);
     innerCommand->isTimeOut = true;
     //set cmd_line for inner command to include 'timeout' in string
     innerCommand->cmd_line = cmd_line;
-    //cout << inner_cmd_line << endl; //DEBUG
-    waitNumber = stoi(str_number);
-    innerCommand->waitNumber = waitNumber;
+    innerCommand->timeoutMilliseconds = timeoutMilliseconds;
 
 }
 
@@ -1068,8 +2401,8 @@ void TimeoutCommand::execute() {
     //in case of built-in command
     if (innerCommand->isBuiltIn) {
         innerCommand->execute();
-        smash->jobs.addTimedProcess(UNINITIALIZED_JOB_ID, UNINITIALIZED_JOB_ID, COMMAND_UNPRINT, waitNumber);
-        smash->jobs.setAlarmSignal();
+        smash->jobs.addTimedProcess(UNINITIALIZED_JOB_ID, UNINITIALIZED_JOB_ID, COMMAND_UNPRINT, timeoutMilliseconds);
+        smash->jobs.armTimeoutTimer();
         return;
     }
     /*
@@ -1081,9 +2414,110 @@ void TimeoutCommand::execute() {
     innerCommand->execute();
 }
 
-ExternalCommand::ExternalCommand(string cmd_line, SmallShell *smash) : BackgroundableCommand(cmd_line, smash) {}
+ExternalCommand::ExternalCommand(std::string_view cmd_line, SmallShell *smash) : BackgroundableCommand(cmd_line, smash),
+    directExec(literalWords && isSimpleCommandLine(args)) {}
+
+bool ExternalCommand::isSimpleCommandLine(const std::pmr::vector<std::string_view> &args) {
+    if (args.empty()) return false;
+    //variable assignment prefix (VAR=value cmd)
+    return args[0].find('=') == string::npos;
+}
+
+void ExternalCommand::execute() {
+    prepareLaunch();
+    BackgroundableCommand::execute();
+}
+
+void ExternalCommand::prepareLaunch() {
+    //resolved in smash, so the result is remembered for the next launch
+    if (directExec && args[0].find('/') == string::npos) {
+        resolvedPath = smash->resolveCommandPath(string(args[0]));
+        //not a program on PATH (may be a bash builtin or keyword) - let bash handle it and report errors
+        if (resolvedPath.empty()) directExec = false;
+    }
+
+    //counted in smash, since the exec itself happens in the forked son
+    if (directExec) ++smash->directExecCount;
+    else ++smash->shellExecCount;
+}
+
+pid_t ExternalCommand::launch() {
+    if (smash->launchBackend == SPAWN_LAUNCH) {
+        StageSetup setup;
+        setup.processGroup = smash->inSmashProcessGroup() ? 0 : -1;
+        return spawn(setup);
+    }
+    return BackgroundableCommand::launch();
+}
+
+/// posix_spawn equivalent of BackgroundableCommand::launch followed by executeBackgroundable.  The process group
+/// escape, pipe ends and signal resets are done through spawn attributes, so smash's memory is never copied
+pid_t ExternalCommand::spawn(const StageSetup &setup) {
+    posix_spawnattr_t attributes;
+    posix_spawn_file_actions_t fileActions;
+    if ((errno = posix_spawnattr_init(&attributes))) throw SmashExceptions::SyscallException("posix_spawnattr_init");
+    if ((errno = posix_spawn_file_actions_init(&fileActions))) {
+        posix_spawnattr_destroy(&attributes);
+        throw SmashExceptions::SyscallException("posix_spawn_file_actions_init");
+    }
+
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+    if (setup.processGroup >= 0) {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attributes, setup.processGroup);
+    }
+    sigset_t defaultSignals, emptyMask;
+    sigemptyset(&defaultSignals);
+    for (int signum : {SIGINT, SIGTSTP, SIGALRM, SIGCHLD, SIGCONT}) sigaddset(&defaultSignals, signum);
+    sigemptyset(&emptyMask);
+    posix_spawnattr_setsigdefault(&attributes, &defaultSignals);
+    posix_spawnattr_setsigmask(&attributes, &emptyMask);
+    posix_spawnattr_setflags(&attributes, flags);
+    //pipe ends are close-on-exec, so only the ones placed on the standard streams survive
+    if (setup.inputFd >= 0) posix_spawn_file_actions_adddup2(&fileActions, setup.inputFd, STDIN_FILENO);
+    if (setup.outputFd >= 0) posix_spawn_file_actions_adddup2(&fileActions, setup.outputFd, setup.outputChannel);
+    if (!outputFile.empty()) {
+        posix_spawn_file_actions_addopen(&fileActions, STDOUT_FILENO, outputFile.c_str(),
+                                         O_WRONLY | O_CREAT | (appendOutput ? O_APPEND : O_TRUNC), 0666);
+    }
+
+    pid_t sonPid = -1;
+    int spawnStatus = -1;
+    TraceScope trace(TRACE_SPAWN);
+    if (directExec) {
+        std::vector<char *> argv;
+        for (std::string_view arg : args) argv.push_back(const_cast<char *>(arg.data())); //words end with '\0'
+        argv.push_back(nullptr);
+        if (!resolvedPath.empty()) {
+            spawnStatus = posix_spawn(&sonPid, resolvedPath.c_str(), &fileActions, &attributes, argv.data(), environ);
+        } else spawnStatus = posix_spawnp(&sonPid, argv[0], &fileActions, &attributes, argv.data(), environ);
+    }
+    if (spawnStatus != 0) {
+        //not exec'able as is - let bash handle it and report errors, just like a failed execv in a forked son
+        string bashCommand = _removeBackgroundSign(cmd_line).c_str(); //stop at the terminator left by the sign removal
+        char *argv[] = {const_cast<char *>("/bin/bash"), const_cast<char *>("-c"), &bashCommand[0], nullptr};
+        spawnStatus = posix_spawn(&sonPid, argv[0], &fileActions, &attributes, argv, environ);
+    }
+
+    posix_spawn_file_actions_destroy(&fileActions);
+    posix_spawnattr_destroy(&attributes);
+    if (spawnStatus) {
+        errno = spawnStatus;
+        throw SmashExceptions::SyscallException("posix_spawn");
+    }
+    return sonPid;
+}
 
 void ExternalCommand::executeBackgroundable() {
+    if (directExec) {
+        std::vector<char *> argv;
+        for (std::string_view arg : args) argv.push_back(const_cast<char *>(arg.data())); //words end with '\0'
+        argv.push_back(nullptr);
+        Tracer::end(TRACE_EXEC, Tracer::sonStart);
+        if (!resolvedPath.empty()) execv(resolvedPath.c_str(), argv.data());
+        else execvp(argv[0], argv.data());
+        //program vanished since it was resolved - let bash handle it and report errors
+    }
+    if (!directExec) Tracer::end(TRACE_EXEC, Tracer::sonStart);
     execl("/bin/bash", "/bin/bash", "-c", _removeBackgroundSign(cmd_line).c_str(), NULL);
 }
-
@@ -3,17 +3,27 @@
 
 #include <vector>
 #include <list>
+#include <deque>
 #include <string>
+#include <string_view>
 #include <map>
+#include <unordered_map>
 #include <memory>
+#include <limits>
 #include <signal.h>
 #include <fstream>
 #include <memory>
 #include <assert.h>
+#include <time.h>
 #include "ProcessControlBlock.h"
+#include "TimerWheel.h"
+#include "IndexedHeap.h"
+#include "Slab.h"
+#include "LineArena.h"
+#include "Tracer.h"
+#include "CommandsHistory.h"
 
 #define COMMAND_ARGS_MAX_LENGTH (200)
-#define COMMAND_MAX_ARGS (20)
 #define HISTORY_MAX_RECORDS (50)
 
 #ifndef NDEBUG
@@ -26,47 +36,156 @@
 typedef int errno_t;
 typedef int job_id_t;
 typedef unsigned int signal_t;
+typedef Slab<ProcessControlBlock>::handle_t job_handle_t;
 
 class Command;
 class SmallShell;
 
+//how smash creates the processes of external commands
+enum LaunchBackend { FORK_LAUNCH, SPAWN_LAUNCH };
+
+//when a job of the after command may start: once all the jobs it waits for succeeded, once any one of them did, or
+//once all of them finished however they did
+enum DependencyPolicy { ALL_DEPENDENCIES, ANY_DEPENDENCY, IGNORE_FAILURES };
+
 bool sendSignal(const ProcessControlBlock& pcb, signal_t sig_num, errno_t* errCodeReturned=nullptr);
 
+//which of the jobs JobsManager::signalJobs signals: all of them, or only those running or stopped (not queued)
+enum JobStateFilter { ALL_JOBS, RUNNING_JOBS, STOPPED_JOBS };
+
+/// what became of a job JobsManager::signalJobs signalled
+struct JobSignalResult {
+    job_id_t jobId;
+    //process group that was signalled, 0 for a queued or blocked job, which has none yet
+    pid_t processGroupId;
+    //errno of the failed killpg, 0 on success
+    int error;
+};
+
 using std::string;
 using std::unique_ptr;
 
-template<class T>
-class Heap : private std::vector<T> {
+/// back-pointer of a stopped job into JobsManager's heap of stopped jobs
+struct StoppedJobPosition {
+    static size_t get(const ProcessControlBlock* pcb) {
+        return pcb->getHeapPosition();
+    }
+    static void set(ProcessControlBlock* pcb, size_t position) {
+        pcb->setHeapPosition(position);
+    }
+};
+
+/// orders jobs by job id, so the top of the heap is the stopped job with the greatest id
+struct JobIdOrder {
+    bool operator()(const ProcessControlBlock* lhs, const ProcessControlBlock* rhs) const {
+        return *lhs < *rhs;
+    }
+};
+
+/// told about jobs as they come and go, by a builtin that waits for jobs it started itself
+class JobListener {
 public:
-    T getMax();
-    void insert(T& newElement);
-    void erase (const T& target);
-    bool empty();
+    virtual ~JobListener() = default;
+    virtual void jobAdded(const ProcessControlBlock& pcb) = 0;
+    /// \param waitStatus wait status of the last process of the job to exit
+    virtual void jobFinished(const ProcessControlBlock& pcb, int waitStatus) = 0;
 };
 
 class JobsManager {
-public:
-    //ROI - list of timed processes
-    std::list<TimedProcessControlBlock> timed_processes;
 private:
-    //Dictionary mapping job_id to process
-    std::map<job_id_t, ProcessControlBlock> processes;
+    //the jobs themselves - they don't move, so pointers to them stay valid until they are erased
+    Slab<ProcessControlBlock> jobTable;
+
+    //handle of the job of each job_id in jobTable (Slab::NO_HANDLE for unused job_ids), ordered by job_id
+    std::vector<job_handle_t> jobHandles;
+
+    //Dictionary mapping pid of a job's process to its job, so that reaped children are found without a scan
+    std::unordered_map<pid_t, job_handle_t> pidIndex;
+
+    //children that are not jobs (foreground process, helpers) but were reaped while draining child events.
+    //Maps pid to its wait status and resource usage, waiting to be claimed by waitChild
+    struct ReapedChild {
+        int status;
+        struct rusage usage;
+    };
+    std::unordered_map<pid_t, ReapedChild> unclaimedChildren;
+
+    //the last HISTORY_MAX_RECORDS jobs that finished, oldest first
+    std::deque<ProcessControlBlock> finishedJobs;
 
     //std::list<ProcessControlBlock*> runQueue;
-    Heap<ProcessControlBlock*> waitingHeap;
+    //stopped jobs, pointing into jobTable
+    IndexedHeap<ProcessControlBlock*, StoppedJobPosition, JobIdOrder> waitingHeap;
+
+    //ROI - pending timeouts, deadlines in milliseconds of the monotonic clock
+    TimerWheel<TimedProcessControlBlock> timeouts;
+
+    //Dictionary mapping pid of a timed process to its timer, to cancel the timeout once the process is done
+    std::unordered_map<pid_t, TimerWheel<TimedProcessControlBlock>::handle_t> timeoutIndex;
+
+    //monotonic timer fd that becomes readable at the next deadline of timeouts, -1 until it is first needed
+    int timerFd = -1;
+
+    //the one listener to job changes, if any
+    JobListener* listener = nullptr;
+
+    //background jobs waiting for a free slot in order of arrival, with the whole command lines to launch them by
+    struct QueuedJob {
+        job_id_t jobId;
+        std::string cmd_line;
+    };
+    std::list<QueuedJob> queuedJobs;
+
+    //jobs of the after command that wait for other jobs, by job handle. Each job they wait for lists them as its
+    //dependents, so they are only touched when one of those finishes
+    struct BlockedJob {
+        std::string cmd_line;
+        std::vector<job_id_t> dependencies;
+        DependencyPolicy policy;
+        //jobs waited for that didn't finish yet
+        size_t unfinished;
+    };
+    std::unordered_map<job_handle_t, BlockedJob> blockedJobs;
+
+    //most background jobs running at once, 0 for no limit
+    unsigned runningLimit = 0;
+
+    //job_id the job being launched from the queue takes over (-1 when none is)
+    job_id_t reservedJobId = -1;
 
     SmallShell& smash;
+    //greatest job_id in use, 0 if there are no jobs
     job_id_t maxIndex = 0;
 
-    job_id_t resetMaxIndex();
+    void eraseJob(job_id_t jobId);
+    /// \param usage resources used by the child, if it was reaped
+    void applyChildStateChange(const siginfo_t& childInfo, const struct rusage& usage);
+
+    /// \return number of jobs that are neither stopped, queued nor blocked
+    size_t runningJobCount() const;
 
 public:
+    /// set when SIGCHLD is read from smash's signal fd, cleared when removeFinishedJobs drains the pending child events
+    static bool childStateChanged;
+
     JobsManager(SmallShell& smash);
     ~JobsManager() = default;
-    void addJob(const Command& cmd, pid_t pid);
+    void addJob(const Command& cmd, const std::vector<pid_t>& pids);
     void addJob(const ProcessControlBlock& pcb);
-    void printJobsList();
+    /// \param showUsage also show the resources used by every job, and the jobs that finished lately
+    void printJobsList(bool showUsage = false);
+
+    /// keep a job that finished in the history of finished jobs
+    void recordFinishedJob(const ProcessControlBlock& pcb);
     void killAllJobs();
+
+    /// signal the process groups of many jobs in one pass over the job table, keeping track of the jobs a signal stops
+    /// or continues. A queued or blocked job has no process group yet, so a signal that would end it drops it instead
+    /// \param states which jobs to signal
+    /// \param firstJobId,lastJobId range of job_ids to signal, inclusive
+    /// \return what became of each job signalled, by ascending job_id
+    std::vector<JobSignalResult> signalJobs(signal_t signum, JobStateFilter states = ALL_JOBS, job_id_t firstJobId = 1,
+                                            job_id_t lastJobId = std::numeric_limits<job_id_t>::max());
     void removeFinishedJobs();
     ProcessControlBlock* getJobById(job_id_t jobId);
     void removeJobById(job_id_t jobId);
@@ -77,16 +196,81 @@ public:
     void registerUnpauseJob(job_id_t jobId); //administrative side of unpausing job
     bool isEmpty();
 
+    JobListener* getListener() const;
+    void setListener(JobListener* listener);
+
+    unsigned getRunningLimit() const;
+    void setRunningLimit(unsigned runningLimit);
+
+    /// \return true if a background job launched now would go over the running limit, so it should be queued instead.
+    /// Jobs of a listener are limited by the listener itself
+    bool mustQueue() const;
+
+    /// add a background job that is launched once there is a free slot for it
+    /// \param creatingCommand command the job is listed by
+    /// \param launchCommandLine whole command line that launches the job
+    void queueJob(const std::string& creatingCommand, const std::string& launchCommandLine);
+
+    /// launch queued jobs, in order, while there are free slots
+    void startQueuedJobs();
+
+    /// remove a queued or blocked job without launching it
+    /// \return command line that would have launched it
+    std::string takeQueuedJob(job_id_t jobId);
+
+    /// add a job that is queued once the jobs it depends on finished, as policy requires
+    /// \param creatingCommand command the job is listed by
+    /// \param launchCommandLine whole command line that launches the job
+    /// \param dependencies job_ids of existing jobs
+    void addBlockedJob(const std::string& creatingCommand, const std::string& launchCommandLine,
+                       const std::vector<job_id_t>& dependencies, DependencyPolicy policy);
+
+    /// tell the jobs waiting for a job that it finished, queueing those that may start now and dropping those that
+    /// may never start (which fails the jobs waiting for them in turn)
+    /// \param dependents job handles of the waiting jobs
+    void resolveDependents(const std::vector<uint64_t>& dependents, bool succeeded);
+
+    /// remove a queued or blocked job, failing the jobs waiting for it
+    void dropJob(job_id_t jobId);
+
+    /// wait until every queued and blocked job was launched, or until ctrl-C / ctrl-Z
+    void waitQueuedJobs();
+
+    /// wait until a child changes state, or until ctrl-C / ctrl-Z
+    void waitChildStateChange();
+
+    /// waitpid for a specific child, which also accepts the child's status if removeFinishedJobs already reaped it
+    /// \param status where to return the wait status to
+    /// \param usage where to return the resources used by the child to, if it was reaped [optional]
+    /// \return pid of child on success, -1 on failure
+    pid_t waitChild(pid_t pid, int* status, int options, struct rusage* usage = nullptr);
+
+    /// wait until every process of a foreground job exited, or until the job was stopped
+    /// \param pcb foreground job, whose exited processes are forgotten
+    /// \return wait status of the last process waited for
+    int waitForeground(ProcessControlBlock& pcb);
+
 
 //ROI
 // note that -2 in pid and jid implies a builtin command
 //AKIVA: why not just use isBuiltIn field of Command class?
+    /// kill the process group of processId when timeoutMilliseconds pass, unless it is done by then
     void addTimedProcess(const job_id_t jobId,
                                       const pid_t processId,
-                                      const std::string& creatingCommand, int futureSeconds, bool flag = false);
+                                      const std::string& creatingCommand, uint64_t timeoutMilliseconds,
+                                      bool flag = false);
+
+    /// forget the timeout of a process that is done
+    void cancelTimeout(pid_t processId);
 
+    /// \return timer fd of the timeouts, created on first use
+    int getTimerFd();
 
-    void setAlarmSignal();
+    /// arm the timer fd for the earliest pending timeout, or disarm it if there is none
+    void armTimeoutTimer();
+
+    /// kill every timed process whose deadline passed (called when the timer fd is readable)
+    void handleTimeouts();
 
 
 };
@@ -105,6 +289,38 @@ private:
 
     const pid_t smashProcessGroup;
 
+    //cache of where on PATH external commands were found
+    struct ResolvedPath {
+        std::string path;
+        unsigned long hits;
+    };
+    std::unordered_map<std::string, ResolvedPath> pathCache;
+    //PATH the cache was built for, and modification times of its directories at that point
+    std::string cachedPathVariable;
+    std::vector<std::pair<std::string, struct timespec>> pathDirectories;
+
+    void revalidatePathCache();
+
+    //the signals smash handles are blocked and read from signalFd instead, outside signal context. epollFd waits for
+    //them, for the timer fd of the jobs and for input at once
+    int signalFd = -1;
+    int epollFd = -1;
+
+    //input read from stdin beyond the lines handed out so far
+    std::string inputBuffer;
+    size_t inputStart = 0;
+    //the history is indexed while smash waits for input, until it was all indexed
+    bool indexingHistory = true;
+
+    /// handle every signal pending on signalFd
+    void handleSignals();
+    /// create the signal fd and the epoll fd that waits for it and for the timer fd of the jobs
+    void openEventFds();
+    /// kill the foreground process
+    void handleCtrlC();
+    /// stop the foreground process and make it a job
+    void handleCtrlZ();
+
 public:
     const ProcessControlBlock *getForegroundProcess() const;
     ProcessControlBlock *getForegroundProcess1() const;
@@ -117,15 +333,19 @@ public:
     /// \return new process group
     signal_t escapeSmashProcessGroup();
 
-    unique_ptr<Command> containedBuild(const string cmd_line);
-    bool containedExecute(const unique_ptr<Command> &cmd);
+    /// parent side of escapeSmashProcessGroup, closes the race of signalling a son before it escaped
+    /// \param pid son that should lead its own process group
+    void escapeSmashProcessGroup(pid_t pid);
+
+    /// \return true if called from smash's own process group (not from a helper process)
+    bool inSmashProcessGroup() const;
+
+    unique_ptr<Command> containedBuild(std::string_view cmd_line);
+    bool containedExecute(const unique_ptr<Command> &cmd, bool inSon = false);
 
 public:
-    TimedProcessControlBlock *getLateProcess(); //ROI
-    void RemoveLateProcesses(); //ROI
     const std::string &getLastPwd() const;
     void setLastPwd(const std::string &lastPwd);
-    bool sendSignal(signal_t signum, job_id_t jobId);
     /*
     bool getIsForgroundTimed() const; //ROI
     void setIsForgroundTimed(bool value); //ROI
@@ -134,8 +354,64 @@ public:
      */
     JobsManager jobs;
 
+    //how many external commands took the direct exec fast path and how many were handed to /bin/bash
+    unsigned long directExecCount = 0;
+    unsigned long shellExecCount = 0;
+
+    LaunchBackend launchBackend = FORK_LAUNCH;
+
+    //memory of the commands of the line being executed, freed at once when the line is done
+    LineArena lineArena;
+
+    CommandsHistory history;
+
+    /// set by the ctrl-C and ctrl-Z handlers to the signal they got, for builtins that wait without a foreground process
+    static int interruptSignal;
+
+    /// block SIGINT, SIGTSTP, SIGCHLD and SIGALRM and read them from a signal fd from now on, so they are handled by
+    /// waitEvents. Called once, before smash forks anything
+    /// \param lazily leave creating the signal fd and the epoll fd to the first waitEvents, for a smash that may never
+    /// wait for anything. The signals stay pending meanwhile, so none is missed
+    void watchSignals(bool lazily = false);
+
+    /// in a forked son, unblock the signals smash reads from its signal fd, so the son gets them as usual
+    void releaseSignals();
+
+    /// wait for signals and timeouts and handle them, until some were handled or inputFd has input
+    /// \param inputFd descriptor to wait for input on as well, -1 for none
+    /// \param timeoutMilliseconds longest time to wait, -1 for no limit
+    /// \return true if inputFd can be read without blocking
+    bool waitEvents(int inputFd = -1, int timeoutMilliseconds = -1);
+
+    /// handle the signals and timeouts that are pending, without waiting (nothing until the fds of watchSignals exist)
+    void pollEvents();
+
+    /// read the next line of stdin, handling signals and timeouts while waiting for it
+    /// \param line where to return the line to, without its '\n'
+    /// \param onIdle called whenever events were handled while no input came, e.g. to reap jobs [optional]
+    /// \return false at the end of input
+    bool readLine(std::string& line, void (*onIdle)(SmallShell&) = nullptr);
+
+    //line executeCommand is running, for commands that need all of it (queued jobs are launched by the whole line)
+    std::string_view executingLine;
+
+    //exit status of the last command line, as bash would report it (128+signal for a killed or stopped process)
+    int lastExitStatus = 0;
+
+    //allocations made while executing the last line
+    unsigned long lastLineHeapAllocations = 0;
+    unsigned long lastLineArenaAllocations = 0;
+    size_t lastLineArenaBytes = 0;
+
+    /// find an external command on PATH, remembering the result until PATH or one of its directories changes
+    /// \param commandName name of the command, without any '/'
+    /// \return absolute path of the command or empty string if not found
+    std::string resolveCommandPath(const std::string& commandName);
+    void printPathCache() const;
+    void resetPathCache();
+
 public:
-    unique_ptr<Command> CreateCommand(std::string cmd_line);
+    unique_ptr<Command> CreateCommand(std::string_view cmd_line);
 
     SmallShell(SmallShell const&)      = delete; // disable copy ctor
 
@@ -149,7 +425,8 @@ public:
 
     ~SmallShell();
 
-    void executeCommand(std::string cmd_line);
+    /// run a command line, setting lastExitStatus
+    void executeCommand(std::string_view cmd_line);
 
     const std::string &getSmashPrompt() const noexcept;
 
@@ -158,159 +435,286 @@ public:
 
 
 class Command {
+private:
+    //the words of args, see _tokenize
+    std::pmr::string argsArena;
+
 protected:
-    std::vector<std::string> args;
+    //words of cmd_line, tokenized once for the command and its subclasses
+    std::pmr::vector<std::string_view> args;
     SmallShell* const smash;
 
 public:
     bool verbose = true;
-    std::string cmd_line = string();
+    std::pmr::string cmd_line;
     bool isBuiltIn = false;
     bool isTimeOut = false;
-    int waitNumber = 0;
+    uint64_t timeoutMilliseconds = 0;
+
+protected:
+    //true if args are all that bash would make of cmd_line (see _tokenize)
+    const bool literalWords;
+
+    /// \param tokenize false for commands made of other commands (pipelines, redirections), which have no words of
+    /// their own - each part is tokenized once, by the command built for it
+    Command(std::string_view cmd_line, SmallShell* smash, bool tokenize);
 
 public:
-    Command(std::string cmd_line, SmallShell* smash);
+    Command(std::string_view cmd_line, SmallShell* smash);
+    Command(const Command&) = delete; //args point into the command's own argsArena
+    Command& operator=(const Command&) = delete;
     virtual ~Command() = default;
+
+    /// commands are allocated in the arena of the line they were built for, so deleting them frees nothing
+    static void* operator new(size_t size);
+    static void operator delete(void* pointer);
     virtual void execute() = 0;
+
+    /// run the command in a son that was already forked for it (a pipe stage), without forking again
+    virtual void executeInSon();
 };
 
 class BuiltInCommand : public Command {
 public:
-    BuiltInCommand(std::string cmd_line, SmallShell* smash);
+    BuiltInCommand(std::string_view cmd_line, SmallShell* smash);
 
     virtual ~BuiltInCommand() = default;
 };
 
+//how the son of a pipe stage sets up its standard streams and process group
+struct StageSetup {
+    //pipe ends to place on stdin and on outputChannel, -1 to keep the inherited ones
+    int inputFd = -1;
+    int outputFd = -1;
+    int outputChannel = 1;
+    //process group to join: 0 to lead a new one, -1 to stay in the parent's
+    pid_t processGroup = -1;
+    //every pipe end of the pipeline, none of which the son may keep open
+    std::vector<int> pipeFds;
+};
+
 class BackgroundableCommand : public Command {
 private:
     pid_t pid=0;
 
 protected:
     bool backgroundRequest = false;
-    bool isRedirectionBuiltinForegroundCommand = false;
+    //every process launch created, if more than the one it returned
+    std::vector<pid_t> sonPids;
+    //file the son's stdout is redirected into (none if empty)
+    string outputFile = string();
+    bool appendOutput = false;
+
+    /// replace stdout of the calling (son) process with outputFile
+    void applyOutputRedirection();
+    BackgroundableCommand(std::string_view cmd_line, SmallShell* smash, bool tokenize);
 public:
-    BackgroundableCommand(string cmd_line, SmallShell* smash);
+    BackgroundableCommand(std::string_view cmd_line, SmallShell* smash);
     virtual ~BackgroundableCommand() = default;
     void execute();
+    void executeInSon() override;
     virtual void executeBackgroundable() = 0;
+
+    /// create the process running executeBackgroundable
+    /// \return pid of the new process (in smash only - the son never returns)
+    virtual pid_t launch();
+
+    void setBackgroundRequest(bool backgroundRequest);
+    void setOutputRedirection(const string& fileName, bool append);
 };
 
 class ExternalCommand : public BackgroundableCommand {
 private:
-    void runExec();
+    //command line needs no shell interpretation, so it may be exec'd directly with the tokenized args
+    bool directExec = false;
+    //where the program was found on PATH (empty for paths containing '/', which are exec'd as they are)
+    string resolvedPath = string();
+
+    static bool isSimpleCommandLine(const std::pmr::vector<std::string_view>& args);
+
 public:
-    ExternalCommand(string cmd_line, SmallShell* smash);
+    ExternalCommand(std::string_view cmd_line, SmallShell* smash);
     virtual ~ExternalCommand() = default;
+    void execute() override;
     void executeBackgroundable() override;
+    pid_t launch() override;
+
+    /// resolve the program and count the launch, in smash, before the son is created
+    void prepareLaunch();
+    /// posix_spawn counterpart of forking a son that runs executeBackgroundable
+    pid_t spawn(const StageSetup& setup);
 };
 
 class PipeCommand : public BackgroundableCommand {
 private:
-    bool errPipe = false;
-    int pidFrom=-1, pidTo=-1;
-    pid_t processGroupFrom = getpgrp();
-    pid_t processGroupTo = processGroupFrom;
-    pid_t *processGroupToPtr=&processGroupTo, *processGroupFromPtr=&processGroupFrom;
-    int pipeSides[2] = {0,0};
-    string cmd_lineFrom=string(), cmd_lineTo=string();
-
-    void commandFromBuiltinExecution();
-    void commandFromNonBuiltinExecution();
-    void commandFromExecution();
-    void commandToExecution();
+    struct Stage {
+        string cmd_line;
+        //stage's stderr (rather than stdout) feeds the next stage
+        bool errPipe;
+    };
+    std::vector<Stage> stages;
 
-protected:
-    unique_ptr<Command> commandFrom=nullptr, commandTo=nullptr;
+    pid_t forkStage(const unique_ptr<Command>& stageCommand, const StageSetup& setup);
 
 public:
-    PipeCommand(std::string cmd_line, SmallShell* smash);
-    PipeCommand(unique_ptr<Command> commandFrom, unique_ptr<Command> commandTo, SmallShell *smash);
-    virtual ~PipeCommand();
+    /// son side of launching a stage: join process group, place pipe ends on the standard streams
+    static void applyStageSetup(const StageSetup& setup);
+
+    PipeCommand(std::string_view cmd_line, SmallShell* smash);
+    virtual ~PipeCommand() = default;
     void executeBackgroundable() override;
+
+    /// create the pipes and launch every stage once, all in one process group
+    /// \return pid of the first stage, which leads the group
+    pid_t launch() override;
 };
 
-class RedirectionCommand : public PipeCommand {
+class RedirectionCommand : public Command {
 private:
+    unique_ptr<Command> innerCommand = nullptr;
+    string targetFile = string();
     bool append = false;
 
-protected:
-    class WriteCommand : public Command{
-        std::ofstream sink = std::ofstream();
-        string closingMessage=string();
-    public:
-        void setClosingMessage(const string &closingMessage);
-
-    public:
-        explicit WriteCommand(string fileName, bool append, SmallShell* smash);
-        virtual ~WriteCommand();
-        virtual void execute() override;
-    };
+    /// run innerCommand inside smash with smash's own stdout temporarily replaced by targetFile
+    void executeInPlace();
 
 public:
-    static void createEmptyFile(const string& cmd_line);
+    static void createEmptyFile(std::string_view cmd_line, size_t operatorPosition);
 
 public:
-    RedirectionCommand(std::string cmd_line, int operatorPosition, SmallShell* smash);
-    RedirectionCommand(unique_ptr<Command> commandFrom, string filename, bool append, SmallShell *smash);
+    RedirectionCommand(std::string_view cmd_line, size_t operatorPosition, SmallShell* smash);
     virtual ~RedirectionCommand() = default;
     void execute() override;
+    void executeInSon() override;
 };
 
 class ChangeDirCommand : public BuiltInCommand {
 public:
-    ChangeDirCommand(std::string cmd_line, SmallShell* smash);
+    ChangeDirCommand(std::string_view cmd_line, SmallShell* smash);
     virtual ~ChangeDirCommand() = default;
     void execute() override;
 };
 
 class GetCurrDirCommand : public BuiltInCommand {
 public:
-    GetCurrDirCommand(std::string cmd_line, SmallShell* smash);
+    GetCurrDirCommand(std::string_view cmd_line, SmallShell* smash);
     virtual ~GetCurrDirCommand() = default;
     void execute() override;
 
     static std::string getCurrDir();
 };
 
+class AllocationsCommand : public BuiltInCommand {
+public:
+    AllocationsCommand(std::string_view cmd_line, SmallShell* smash);
+    virtual ~AllocationsCommand() = default;
+    void execute() override;
+};
+
 class ShowPidCommand : public BuiltInCommand {
 public:
-    ShowPidCommand(string cmd_line, SmallShell* smash);
+    ShowPidCommand(std::string_view cmd_line, SmallShell* smash);
     virtual ~ShowPidCommand() = default;
     void execute() override;
 };
 
+class HashCommand : public BuiltInCommand {
+private:
+    bool resetRequest = false;
+public:
+    HashCommand(std::string_view cmd_line, SmallShell* smash);
+    virtual ~HashCommand() = default;
+    void execute() override;
+};
+
+class LaunchCommand : public BuiltInCommand {
+private:
+    bool setBackend = false;
+    LaunchBackend backend = FORK_LAUNCH;
+public:
+    LaunchCommand(std::string_view cmd_line, SmallShell* smash);
+    virtual ~LaunchCommand() = default;
+    void execute() override;
+};
+
+class TraceCommand : public BuiltInCommand {
+private:
+    enum TraceAction {PRINT_TRACING, START_TRACING, STOP_TRACING, DUMP_TRACE};
+    TraceAction action = PRINT_TRACING;
+    std::string fileName;
+public:
+    TraceCommand(std::string_view cmd_line, SmallShell* smash);
+    virtual ~TraceCommand() = default;
+    void execute() override;
+};
+
+class ParallelCommand : public BuiltInCommand, private JobListener {
+private:
+    //a command line running as a job
+    struct Running {
+        size_t index;
+        std::string cmd_line;
+        uint64_t startTime;
+    };
+
+    unsigned workers;
+    //command lines given as arguments, without blank ones
+    std::vector<std::string> commandLines;
+    //no command lines were given as arguments, so they are read from stdin
+    bool readInput = false;
+    //how many command lines were started, and how many of them failed
+    size_t started = 0;
+    size_t failures = 0;
+    //command line being launched, and whether it became a job
+    const Running* launching = nullptr;
+    bool launchedJob = false;
+    //running command lines by pid of their job
+    std::unordered_map<pid_t, Running> running;
+
+    bool nextCommandLine(std::string& commandLine);
+    void start(const std::string& commandLine);
+    void report(const Running& command, int exitStatus);
+
+    void jobAdded(const ProcessControlBlock& pcb) override;
+    void jobFinished(const ProcessControlBlock& pcb, int waitStatus) override;
+
+public:
+    ParallelCommand(std::string_view cmd_line, SmallShell* smash);
+    virtual ~ParallelCommand() = default;
+    void execute() override;
+};
+
 class QuitCommand : public BuiltInCommand {
 private:
     bool killRequest = false;
 public:
-    QuitCommand(string cmd_line, SmallShell* smash);
+    QuitCommand(std::string_view cmd_line, SmallShell* smash);
     virtual ~QuitCommand() = default;
     void execute() override;
 };
 
-/*
-class CommandsHistory {
- protected:
-  class CommandHistoryEntry {
-  };
- public:
-  CommandsHistory();
-  ~CommandsHistory() = default;
-  void addRecord(const char* cmd_line);
-  void printHistory();
-};
-
 class HistoryCommand : public BuiltInCommand {
- public:
-  HistoryCommand(const char* cmd_line, CommandsHistory* history);
-  virtual ~HistoryCommand() = default;
-  void execute() override;
-};*/
+private:
+    //history -s <substring> shows the latest lines containing substring instead of the last lines
+    bool searchRequest = false;
+    std::string substring;
+public:
+    HistoryCommand(std::string_view cmd_line, SmallShell* smash);
+    virtual ~HistoryCommand() = default;
+    void execute() override;
+};
 
 class JobsCommand : public BuiltInCommand {
+private:
+    //jobs -v shows the resources used by the jobs as well
+    bool usageRequest = false;
+    //jobs --limit [N] shows or sets the running limit instead of listing the jobs
+    bool limitRequest = false;
+    bool setLimit = false;
+    unsigned limit = 0;
+
 public:
-    JobsCommand(string cmd_line, SmallShell* smash);
+    JobsCommand(std::string_view cmd_line, SmallShell* smash);
     virtual ~JobsCommand() = default;
     void execute() override;
 };
@@ -319,7 +723,7 @@ class KillCommand : public BuiltInCommand {
     signal_t signum = -1;
     job_id_t jobId = -1;
 public:
-    KillCommand(string cmd_line, SmallShell* smash);
+    KillCommand(std::string_view cmd_line, SmallShell* smash);
     virtual ~KillCommand() = default;
     void execute() override;
 };
@@ -330,7 +734,7 @@ private:
     ProcessControlBlock* pcb = nullptr;
 
 public:
-    ForegroundCommand(string cmd_line, SmallShell* smash);
+    ForegroundCommand(std::string_view cmd_line, SmallShell* smash);
     virtual ~ForegroundCommand() = default;
     void execute() override;
 };
@@ -340,36 +744,49 @@ class BackgroundCommand : public BuiltInCommand {
     ProcessControlBlock* pcb = nullptr;
 
 public:
-    BackgroundCommand(string cmd_line, SmallShell* smash);
+    BackgroundCommand(std::string_view cmd_line, SmallShell* smash);
     virtual ~BackgroundCommand() = default;
     void execute() override;
 };
 
-class CopyCommand : public RedirectionCommand {
+class CopyCommand : public BackgroundableCommand {
 private:
-    class ReadCommand : public Command{
-        std::ifstream source;
-        void read();
-    public:
-        explicit ReadCommand(string fileName, SmallShell* smash);
-        virtual ~ReadCommand();
-        void execute();
-    };
+    string sourceFile = string(), targetFile = string();
+    //threads copying ranges of the file at once (cp -j), 0 to copy it as a single stream
+    unsigned workers = 0;
+    //compare checksums of the source and of the copy once it is done (cp --verify)
+    bool verify = false;
 
-    string getSourceFile(std::vector<std::string> args);
-    string getTargetFile(std::vector<std::string> args);
+    static bool isSameFile(string fileFrom, string fileTo);
 
-private:
-    bool isSameFile(string fileFrom, string fileTo);
+    /// copy everything left in one file descriptor into another, inside the kernel where possible
+    /// \return number of bytes copied
+    static off_t copyContents(int sourceFd, int targetFd);
+
+    /// copy the first size bytes of a regular file into another, in ranges handed out to worker threads
+    static void copyRanges(int sourceFd, int targetFd, off_t size, unsigned workers);
+
+    /// compare the CRC-32C of every range of the first size bytes of two files, computed by worker threads
+    /// \return true if they all match
+    static bool verifyRanges(int sourceFd, int targetFd, off_t size, unsigned workers);
 
 public:
-    CopyCommand(string cmd_line, SmallShell* smash);
+    CopyCommand(std::string_view cmd_line, SmallShell* smash);
     virtual ~CopyCommand() = default;
-    void execute() override;
+    void executeBackgroundable() override;
+};
 
-    //checks if file we're copying from is the file we're copying to.  Needs a parameter to pass along without
-    // modification to allow usage in the initializer list
-    ReadCommand *duplicityCheck(ReadCommand *passAlong, const std::vector<std::string>& args);
+class AfterCommand : public BuiltInCommand {
+private:
+    DependencyPolicy policy = ALL_DEPENDENCIES;
+    std::vector<job_id_t> dependencies;
+    //the command to run, from the rest of the line
+    std::string commandLine;
+
+public:
+    AfterCommand(std::string_view cmd_line, SmallShell* smash);
+    virtual ~AfterCommand() = default;
+    void execute() override;
 };
 
 class ChpromptCommand : public BuiltInCommand {
@@ -377,7 +794,7 @@ private:
     const std::string newPrompt;
 
 public:
-    ChpromptCommand(string cmd_line, SmallShell* smash);
+    ChpromptCommand(std::string_view cmd_line, SmallShell* smash);
     virtual ~ChpromptCommand() = default;
     void execute() override;
 };
@@ -391,9 +808,9 @@ class TimeoutCommand : public Command {
 
 private:
     bool backgroundRequest = false;
-    int waitNumber;
+    uint64_t timeoutMilliseconds;
 public:
-    TimeoutCommand(string cmd_line, SmallShell* smash);
+    TimeoutCommand(std::string_view cmd_line, SmallShell* smash);
     virtual ~TimeoutCommand() = default;
     void execute() override;
 };
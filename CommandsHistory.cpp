@@ -0,0 +1,203 @@
+#include "CommandsHistory.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include "Commands.h"
+
+//lists of the index. Trigrams are hashed into them, so that the index stays small enough to be built in cache - a
+//list also holding the blocks of other trigrams only makes for candidates that aren't matches
+static const uint32_t TRIGRAM_BUCKET_BITS = 16;
+
+//entries of the log a posting of the index stands for. Larger blocks make a smaller index, which is quicker to
+//build, at the cost of more entries to check for every candidate block
+static const size_t ENTRIES_PER_BLOCK = 16;
+//entries buildIndex indexes at a time, a millisecond or two of work
+static const size_t INDEX_STEP_ENTRIES = 16384;
+
+/// \return the three characters that end with character, given the ones before it
+static uint32_t _nextTrigram(uint32_t trigram, char character) {
+    return ((trigram << 8) | (unsigned char) character) & 0xFFFFFF;
+}
+
+static uint32_t _trigramBucket(uint32_t trigram) {
+    return (trigram * 2654435761u) >> (32 - TRIGRAM_BUCKET_BITS);
+}
+
+CommandsHistory::~CommandsHistory() {
+    if (mapping) munmap(const_cast<char *>(mapping), mappedSize);
+    if (fd >= 0) close(fd);
+}
+
+void CommandsHistory::setRecording(bool recording) {
+    CommandsHistory::recording = recording;
+}
+
+bool CommandsHistory::isRecording() const {
+    return recording;
+}
+
+void CommandsHistory::open() {
+    const char *configuredPath = getenv("SMASH_HISTORY");
+    if (configuredPath) path = configuredPath;
+    else {
+        const char *home = getenv("HOME");
+        if (!home) throw SmashExceptions::Exception("history", "HOME is not set");
+        path = std::string(home) + "/.smash_history";
+    }
+    fd = ::open(path.c_str(), O_RDWR | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) throw SmashExceptions::SyscallException("open");
+}
+
+void CommandsHistory::addRecord(std::string_view cmd_line) {
+    if (!recording || cmd_line.find_first_not_of(" \t\r") == std::string_view::npos) return;
+    if (fd < 0) open();
+    //a single O_APPEND write, so lines of concurrent sessions never interleave
+    struct iovec record[2] = {{const_cast<char *>(cmd_line.data()), cmd_line.length()},
+                              {const_cast<char *>("\n"), 1}};
+    if (writev(fd, record, 2) < 0) throw SmashExceptions::SyscallException("writev");
+}
+
+void CommandsHistory::refresh() {
+    if (fd < 0) open();
+    struct stat logStat;
+    if (fstat(fd, &logStat) < 0) throw SmashExceptions::SyscallException("fstat");
+    const size_t logSize = logStat.st_size;
+
+    if (logSize < parsedSize) {
+        //the log was cut short behind smash's back - start over
+        entryOffsets.clear();
+        trigramIndex.clear();
+        parsedSize = indexedEntries = 0;
+    }
+    if (logSize != mappedSize) {
+        if (mapping) munmap(const_cast<char *>(mapping), mappedSize);
+        mapping = nullptr;
+        mappedSize = 0;
+        if (logSize > 0) {
+            void *newMapping = mmap(nullptr, logSize, PROT_READ, MAP_SHARED, fd, 0);
+            if (newMapping == MAP_FAILED) throw SmashExceptions::SyscallException("mmap");
+            mapping = static_cast<const char *>(newMapping);
+            mappedSize = logSize;
+        }
+    }
+
+    //a line another session is in the middle of writing is parsed once it is whole
+    const char *const end = mapping + mappedSize;
+    for (const char *lineStart = mapping + parsedSize; lineStart < end;) {
+        const char *newline = static_cast<const char *>(memchr(lineStart, '\n', end - lineStart));
+        if (!newline) break;
+        entryOffsets.push_back(lineStart - mapping);
+        lineStart = newline + 1;
+        parsedSize = lineStart - mapping;
+    }
+}
+
+void CommandsHistory::indexNewEntries(size_t limit) {
+    if (trigramIndex.empty()) trigramIndex.resize(1 << TRIGRAM_BUCKET_BITS);
+    const size_t end = std::min(entryOffsets.size(), indexedEntries + limit);
+    for (; indexedEntries < end; ++indexedEntries) {
+        const uint32_t block = indexedEntries / ENTRIES_PER_BLOCK;
+        const std::string_view text = entry(indexedEntries);
+        uint32_t trigram = '\n';
+        for (size_t i = 0; i < text.length(); ++i) {
+            trigram = _nextTrigram(trigram, text[i]);
+            if (i == 0) continue; //only two characters so far
+            std::vector<uint32_t> &blocks = trigramIndex[_trigramBucket(trigram)];
+            //once per block, however often the trigram appears in it
+            if (blocks.empty() || blocks.back() != block) blocks.push_back(block);
+        }
+    }
+}
+
+bool CommandsHistory::buildIndex() {
+    refresh();
+    indexNewEntries(INDEX_STEP_ENTRIES);
+    return indexedEntries < entryOffsets.size();
+}
+
+std::string_view CommandsHistory::entry(size_t index) const {
+    const uint64_t start = entryOffsets[index];
+    const uint64_t end = (index + 1 < entryOffsets.size()) ? entryOffsets[index + 1] : parsedSize;
+    return std::string_view(mapping + start, end - start - 1); //without the '\n'
+}
+
+std::vector<size_t> CommandsHistory::search(std::string_view pattern, size_t limit) {
+    refresh();
+    const bool prefixSearch = !pattern.empty() && pattern[0] == '\n';
+    const std::string_view text = prefixSearch ? pattern.substr(1) : pattern;
+    auto matches = [prefixSearch, text](std::string_view entry) {
+        return prefixSearch ? entry.substr(0, text.length()) == text : entry.find(text) != std::string_view::npos;
+    };
+
+    std::vector<size_t> found;
+    if (pattern.length() < 3) {
+        //too short for a trigram - the latest entries are checked one by one, until there are enough matches
+        for (size_t index = entryOffsets.size(); index-- > 0 && found.size() < limit;) {
+            if (matches(entry(index))) found.push_back(index);
+        }
+    } else {
+        indexNewEntries(entryOffsets.size());
+        //candidate blocks come from the shortest list of blocks holding one of the trigrams, and must be in the others
+        std::vector<const std::vector<uint32_t> *> lists;
+        const std::vector<uint32_t> *shortest = nullptr;
+        uint32_t trigram = _nextTrigram((unsigned char) pattern[0], pattern[1]);
+        for (size_t i = 2; i < pattern.length(); ++i) {
+            trigram = _nextTrigram(trigram, pattern[i]);
+            const std::vector<uint32_t> &blocks = trigramIndex[_trigramBucket(trigram)];
+            if (blocks.empty()) return found;
+            lists.push_back(&blocks);
+            if (!shortest || blocks.size() < shortest->size()) shortest = &blocks;
+        }
+        for (auto candidate = shortest->rbegin(); candidate != shortest->rend() && found.size() < limit; ++candidate) {
+            bool inEveryList = true;
+            for (const std::vector<uint32_t> *blocks : lists) {
+                if (blocks != shortest && !std::binary_search(blocks->begin(), blocks->end(), *candidate)) {
+                    inEveryList = false;
+                    break;
+                }
+            }
+            if (!inEveryList) continue;
+            //the trigrams may all be there without forming the pattern, or without being in the same entry
+            const size_t first = (size_t) *candidate * ENTRIES_PER_BLOCK;
+            for (size_t index = std::min(first + ENTRIES_PER_BLOCK, entryOffsets.size());
+                 index-- > first && found.size() < limit;) {
+                if (matches(entry(index))) found.push_back(index);
+            }
+        }
+    }
+    std::reverse(found.begin(), found.end());
+    return found;
+}
+
+void CommandsHistory::printEntry(size_t index) const {
+    std::cout << std::setw(5) << index + 1 << "  " << entry(index) << std::endl;
+}
+
+void CommandsHistory::printHistory(size_t count) {
+    refresh();
+    for (size_t index = entryOffsets.size() - std::min(count, entryOffsets.size()); index < entryOffsets.size(); ++index) {
+        printEntry(index);
+    }
+}
+
+void CommandsHistory::printMatches(std::string_view substring, size_t count) {
+    for (size_t index : search(substring, count)) printEntry(index);
+}
+
+bool CommandsHistory::findPrefix(std::string_view prefix, std::string &result) {
+    std::vector<size_t> found;
+    if (prefix == "!") {
+        refresh();
+        if (!entryOffsets.empty()) found.push_back(entryOffsets.size() - 1);
+    } else found = search("\n" + std::string(prefix), 1);
+    if (found.empty()) return false;
+    result = std::string(entry(found.front()));
+    return true;
+}
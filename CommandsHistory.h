@@ -0,0 +1,80 @@
+#ifndef OS_HW1_COMMANDSHISTORY_H
+#define OS_HW1_COMMANDSHISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/// History of the command lines typed at the prompt, shared by every smash of the user. It is an append-only log file
+/// ($SMASH_HISTORY, or ~/.smash_history) holding an entry per line, which sessions append to with O_APPEND writes and
+/// read through a shared mapping. Nothing is read before the history is first looked up, so a large log costs smash
+/// nothing at startup; each lookup then parses and indexes only what the log gained since the one before it
+class CommandsHistory {
+private:
+    std::string path;
+    int fd = -1;
+    const char *mapping = nullptr;
+    size_t mappedSize = 0;
+
+    //keep lines added to the history, which smash does for lines typed at an interactive prompt only
+    bool recording = false;
+
+    //offset in the log of every entry parsed so far, and where parsing goes on from (after the last whole line)
+    std::vector<uint64_t> entryOffsets;
+    uint64_t parsedSize = 0;
+
+    //blocks of consecutive entries containing each trigram of '\n' followed by an entry, ascending, by hash of the
+    //trigram. The '\n' anchors trigrams to the start of an entry, so prefixes are looked up like any other substring
+    std::vector<std::vector<uint32_t>> trigramIndex;
+    //entries already in trigramIndex, which is only built once a lookup needs it
+    size_t indexedEntries = 0;
+
+    /// open the log, creating it if needed
+    void open();
+
+    /// map the whole log and parse the entries other sessions (or this one) added since the last call
+    void refresh();
+
+    /// add the entries parsed since the last call to trigramIndex, at most limit of them
+    void indexNewEntries(size_t limit);
+
+    std::string_view entry(size_t index) const;
+
+    /// \param pattern substring to look for in '\n' followed by the entry
+    /// \return indexes of the latest entries containing pattern, at most limit of them, oldest first
+    std::vector<size_t> search(std::string_view pattern, size_t limit);
+
+    void printEntry(size_t index) const;
+
+public:
+    CommandsHistory() = default;
+    CommandsHistory(const CommandsHistory &) = delete;
+    CommandsHistory &operator=(const CommandsHistory &) = delete;
+    ~CommandsHistory();
+
+    void setRecording(bool recording);
+    bool isRecording() const;
+
+    /// index a slice of the entries not indexed yet, so that the first lookup needn't index the whole log. Smash calls
+    /// it while it waits for input
+    /// \return true if there are entries left to index
+    bool buildIndex();
+
+    /// append a command line to the log, unless it is blank or lines aren't recorded
+    void addRecord(std::string_view cmd_line);
+
+    /// print the last count entries, numbered from the first entry of the log
+    void printHistory(size_t count);
+
+    /// print the latest entries containing substring, at most count of them
+    void printMatches(std::string_view substring, size_t count);
+
+    /// \param prefix start of the entry to find, "!" for the last entry
+    /// \param result where to return the latest entry starting with prefix to
+    /// \return false if there is no such entry
+    bool findPrefix(std::string_view prefix, std::string &result);
+};
+
+#endif //OS_HW1_COMMANDSHISTORY_H
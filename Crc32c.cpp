@@ -0,0 +1,50 @@
+#include "Crc32c.h"
+#include <string.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+//Castagnoli polynomial, bit reversed
+static const uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;
+
+struct Crc32cTable {
+    uint32_t entries[256];
+
+    Crc32cTable() {
+        for (uint32_t byte = 0; byte < 256; ++byte) {
+            uint32_t crc = byte;
+            for (int bit = 0; bit < 8; ++bit) crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLYNOMIAL : 0);
+            entries[byte] = crc;
+        }
+    }
+};
+
+static uint32_t _crc32cSoftware(uint32_t crc, const unsigned char *data, size_t length) {
+    static const Crc32cTable table;
+    while (length--) crc = (crc >> 8) ^ table.entries[(crc ^ *data++) & 0xFF];
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t _crc32cHardware(uint32_t crc, const unsigned char *data, size_t length) {
+    uint64_t wideCrc = crc;
+    for (; length >= sizeof(uint64_t); data += sizeof(uint64_t), length -= sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word)); //data need not be aligned
+        wideCrc = _mm_crc32_u64(wideCrc, word);
+    }
+    crc = (uint32_t) wideCrc;
+    while (length--) crc = _mm_crc32_u8(crc, *data++);
+    return crc;
+}
+#endif
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t length) {
+    const unsigned char *bytes = static_cast<const unsigned char *>(data);
+#if defined(__x86_64__)
+    static const bool hardware = __builtin_cpu_supports("sse4.2");
+    if (hardware) return ~_crc32cHardware(~crc, bytes, length);
+#endif
+    return ~_crc32cSoftware(~crc, bytes, length);
+}
@@ -0,0 +1,11 @@
+#ifndef OS_HW1_CRC32C_H
+#define OS_HW1_CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// CRC-32C (Castagnoli) of data, continuing a checksum of the data before it (0 at the start). Uses the SSE4.2 crc32
+/// instruction, 8 bytes at a time, when the CPU has it, and a table otherwise
+uint32_t crc32c(uint32_t crc, const void *data, size_t length);
+
+#endif //OS_HW1_CRC32C_H
@@ -0,0 +1,107 @@
+#ifndef OS_HW1_INDEXEDHEAP_H
+#define OS_HW1_INDEXEDHEAP_H
+
+#include <stddef.h>
+#include <functional>
+#include <vector>
+
+/// Binary max-heap of handles (e.g. pointers) to elements that store their own position in the heap.
+/// Position is a policy with static size_t get(const T&) and static void set(T&, size_t), used for the back-pointers;
+/// elements that are not in the heap have position NOT_IN_HEAP.
+/// Insert, erase and update are O(log n), top is O(1).
+template<class T, class Position, class Compare = std::less<T> >
+class IndexedHeap {
+public:
+    static const size_t NOT_IN_HEAP = (size_t) -1;
+
+private:
+    std::vector<T> elements;
+    Compare compare;
+
+    void place(size_t position, const T &element) {
+        elements[position] = element;
+        Position::set(elements[position], position);
+    }
+
+    void siftUp(size_t position) {
+        T element = elements[position];
+        while (position > 0) {
+            size_t parent = (position - 1) / 2;
+            if (!compare(elements[parent], element)) break;
+            place(position, elements[parent]);
+            position = parent;
+        }
+        place(position, element);
+    }
+
+    void siftDown(size_t position) {
+        T element = elements[position];
+        const size_t size = elements.size();
+        while (true) {
+            size_t child = 2 * position + 1;
+            if (child >= size) break;
+            if (child + 1 < size && compare(elements[child], elements[child + 1])) ++child;
+            if (!compare(element, elements[child])) break;
+            place(position, elements[child]);
+            position = child;
+        }
+        place(position, element);
+    }
+
+public:
+    explicit IndexedHeap(const Compare &compare = Compare()) : compare(compare) {}
+
+    /// \return true if element is in the heap, judging by its back-pointer
+    bool contains(const T &element) const {
+        size_t position = Position::get(element);
+        return position < elements.size() && elements[position] == element;
+    }
+
+    /// insert element, or only restore its order if it is already in the heap
+    void insert(T element) {
+        if (contains(element)) {
+            update(element);
+            return;
+        }
+        elements.push_back(element);
+        siftUp(elements.size() - 1);
+    }
+
+    /// remove element from the heap, if it is there
+    void erase(T element) {
+        if (!contains(element)) return;
+        const size_t position = Position::get(element);
+        Position::set(element, NOT_IN_HEAP);
+        T last = elements.back();
+        elements.pop_back();
+        if (position == elements.size()) return;
+        place(position, last);
+        update(last);
+    }
+
+    /// restore the heap order after the key of element changed
+    void update(const T &element) {
+        const size_t position = Position::get(element);
+        if (position > 0 && compare(elements[(position - 1) / 2], element)) siftUp(position);
+        else siftDown(position);
+    }
+
+    /// \return the greatest element by Compare - the heap must not be empty
+    const T &top() const {
+        return elements.front();
+    }
+
+    void pop() {
+        erase(elements.front());
+    }
+
+    bool empty() const {
+        return elements.empty();
+    }
+
+    size_t size() const {
+        return elements.size();
+    }
+};
+
+#endif //OS_HW1_INDEXEDHEAP_H
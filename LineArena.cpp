@@ -0,0 +1,142 @@
+#include "LineArena.h"
+#include <stdlib.h>
+#include <new>
+#include <atomic>
+#include <cstddef>
+
+//atomic, as the worker threads of cp -j allocate concurrently. Relaxed - it is only a count
+static std::atomic<unsigned long> heapAllocations(0);
+
+/// allocate for one of the global operator new overloads, counting the allocation
+/// \return nullptr if the heap is exhausted
+static void *_countedAllocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    if (!size) size = 1;
+    if (alignment <= alignof(std::max_align_t)) return malloc(size);
+    void *result = nullptr;
+    return posix_memalign(&result, alignment, size) ? nullptr : result;
+}
+
+static void *_countedAllocateOrThrow(size_t size, size_t alignment = alignof(std::max_align_t)) {
+    void *result = _countedAllocate(size, alignment);
+    if (!result) throw std::bad_alloc();
+    return result;
+}
+
+//every heap allocation of smash goes through one of these, so it can be counted. All of them are replaced together,
+//as memory from any of them may be given back through any matching operator delete
+void *operator new(size_t size) {
+    return _countedAllocateOrThrow(size);
+}
+
+void *operator new[](size_t size) {
+    return _countedAllocateOrThrow(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    return _countedAllocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return _countedAllocate(size);
+}
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    return _countedAllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+    return _countedAllocateOrThrow(size, static_cast<size_t>(alignment));
+}
+
+void *operator new(size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return _countedAllocate(size, static_cast<size_t>(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+    return _countedAllocate(size, static_cast<size_t>(alignment));
+}
+
+//malloc and posix_memalign memory alike is given back with free
+void operator delete(void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t, std::align_val_t) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer, size_t, std::align_val_t) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, std::align_val_t, const std::nothrow_t &) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer, std::align_val_t, const std::nothrow_t &) noexcept {
+    free(pointer);
+}
+
+unsigned long heapAllocationCount() {
+    return heapAllocations.load(std::memory_order_relaxed);
+}
+
+LineArena::LineArena() : firstBlock(new char[FIRST_BLOCK_SIZE]),
+    arena(firstBlock.get(), FIRST_BLOCK_SIZE, std::pmr::new_delete_resource()) {}
+
+void *LineArena::do_allocate(size_t bytes, size_t alignment) {
+    lineBytes += bytes;
+    ++lineAllocations;
+    return arena.allocate(bytes, alignment);
+}
+
+void LineArena::do_deallocate(void *, size_t, size_t) {
+    //memory is only given back by reset
+}
+
+bool LineArena::do_is_equal(const std::pmr::memory_resource &other) const noexcept {
+    return this == &other;
+}
+
+void LineArena::reset() {
+    arena.release();
+    lineBytes = 0;
+    lineAllocations = 0;
+}
+
+size_t LineArena::getLineBytes() const {
+    return lineBytes;
+}
+
+unsigned long LineArena::getLineAllocations() const {
+    return lineAllocations;
+}
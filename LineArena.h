@@ -0,0 +1,41 @@
+#ifndef OS_HW1_LINEARENA_H
+#define OS_HW1_LINEARENA_H
+
+#include <stddef.h>
+#include <memory>
+#include <memory_resource>
+
+/// \return how many times one of the global operator new overloads was called since smash started
+unsigned long heapAllocationCount();
+
+/// Monotonic memory resource for everything built for a single command line (the Command objects and their strings).
+/// Deallocation does nothing; reset() frees the whole line at once, after which the first block is reused, so lines
+/// that fit in it don't touch the heap at all.
+class LineArena : public std::pmr::memory_resource {
+private:
+    static const size_t FIRST_BLOCK_SIZE = 64 * 1024;
+
+    std::unique_ptr<char[]> firstBlock;
+    std::pmr::monotonic_buffer_resource arena;
+
+    //statistics of the current line
+    size_t lineBytes = 0;
+    unsigned long lineAllocations = 0;
+
+    void *do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void *pointer, size_t bytes, size_t alignment) override;
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override;
+
+public:
+    LineArena();
+    LineArena(const LineArena &) = delete;
+    LineArena &operator=(const LineArena &) = delete;
+
+    /// free everything allocated since the last reset - nothing allocated from the arena may be used afterwards
+    void reset();
+
+    size_t getLineBytes() const;
+    unsigned long getLineAllocations() const;
+};
+
+#endif //OS_HW1_LINEARENA_H
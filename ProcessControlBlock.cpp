@@ -7,6 +7,8 @@
 #include <iostream>
 #include <cstring>
 #include <unistd.h>
+#include <sys/time.h>
+#include <algorithm>
 
 #define DEBUG_PRINT(err_msg) /*std::cerr << "DEBUG: " << err_msg << std::endl */
 
@@ -17,6 +19,7 @@ ProcessControlBlock::ProcessControlBlock(const job_id_t jobId,
     jobId(jobId),
     processId(processId),
     processGroupId(processId),
+    processIds(1, processId),
     creatingCommand(creatingCommand),
     startTime(time(nullptr))
     {}
@@ -42,6 +45,14 @@ void ProcessControlBlock::setRunning(bool running) {
     ProcessControlBlock::running = running;
 }
 
+void ProcessControlBlock::setQueued(bool queued) {
+    ProcessControlBlock::queued = queued;
+}
+
+bool ProcessControlBlock::isQueued() const {
+    return queued;
+}
+
 bool ProcessControlBlock::operator==(const ProcessControlBlock &rhs) const {
     return jobId == rhs.jobId;
 }
@@ -74,6 +85,69 @@ void ProcessControlBlock::setProcessId(pid_t processId) {
     ProcessControlBlock::processId = processId;
 }
 
+const std::vector<pid_t> &ProcessControlBlock::getProcessIds() const {
+    return processIds;
+}
+
+void ProcessControlBlock::setProcessIds(const std::vector<pid_t> &processIds) {
+    ProcessControlBlock::processIds = processIds;
+}
+
+bool ProcessControlBlock::removeProcessId(pid_t processId) {
+    for (auto it = processIds.begin(); it != processIds.end(); ++it) {
+        if (*it == processId) {
+            processIds.erase(it);
+            break;
+        }
+    }
+    return !processIds.empty();
+}
+
+size_t ProcessControlBlock::getHeapPosition() const {
+    return heapPosition;
+}
+
+const std::vector<uint64_t> &ProcessControlBlock::getDependents() const {
+    return dependents;
+}
+
+void ProcessControlBlock::addDependent(uint64_t dependent) {
+    dependents.push_back(dependent);
+}
+
+void ProcessControlBlock::setDependents(const std::vector<uint64_t> &dependents) {
+    ProcessControlBlock::dependents = dependents;
+}
+
+const struct rusage &ProcessControlBlock::getUsage() const {
+    return usage;
+}
+
+void ProcessControlBlock::addUsage(const struct rusage &processUsage) {
+    timeradd(&usage.ru_utime, &processUsage.ru_utime, &usage.ru_utime);
+    timeradd(&usage.ru_stime, &processUsage.ru_stime, &usage.ru_stime);
+    usage.ru_maxrss = std::max(usage.ru_maxrss, processUsage.ru_maxrss);
+    usage.ru_nvcsw += processUsage.ru_nvcsw;
+    usage.ru_nivcsw += processUsage.ru_nivcsw;
+}
+
+int ProcessControlBlock::getWaitStatus() const {
+    return waitStatus;
+}
+
+time_t ProcessControlBlock::getFinishTime() const {
+    return finishTime;
+}
+
+void ProcessControlBlock::setFinished(int waitStatus) {
+    ProcessControlBlock::waitStatus = waitStatus;
+    finishTime = time(nullptr);
+}
+
+void ProcessControlBlock::setHeapPosition(size_t heapPosition) {
+    ProcessControlBlock::heapPosition = heapPosition;
+}
+
 time_t ProcessControlBlock::getStartTime() const {
     return startTime;
 }
@@ -107,13 +181,13 @@ std::ostream& operator<<(std::ostream &outstream, ProcessControlBlock &pcb) {
 //Roi timed process functions
 TimedProcessControlBlock::TimedProcessControlBlock(const job_id_t jobId,
                                                    const pid_t processId,
-                                                   const std::string& creatingCommand, int futureSeconds, bool flag) :
+                                                   const std::string& creatingCommand, uint64_t abortTime, bool flag) :
         ProcessControlBlock(jobId, processId, creatingCommand),
-        abortTime(startTime+futureSeconds),
+        abortTime(abortTime),
         isBackground(flag)
 {}
 
-time_t TimedProcessControlBlock::getAbortTime() const {
+uint64_t TimedProcessControlBlock::getAbortTime() const {
     return abortTime;
 }
 
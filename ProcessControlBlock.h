@@ -6,7 +6,10 @@
 #define OS_HW1_PROCESSCONTROLBLOCK_H
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <sys/resource.h>
 #include <string>
+#include <vector>
 #include <ostream>
 
 typedef int job_id_t;
@@ -17,9 +20,22 @@ protected:
     job_id_t jobId;
     pid_t processId;
     pid_t processGroupId;
+    //processes of the job that didn't exit yet (all stages of a pipeline, led by processId)
+    std::vector<pid_t> processIds;
     bool running = true;
-    const std::string creatingCommand;
+    //job waits for a free slot to be launched in, and has no processes yet
+    bool queued = false;
+    std::string creatingCommand;
     time_t startTime;
+    //index of the job in the heap of stopped jobs, kept by the heap itself
+    size_t heapPosition = (size_t) -1;
+    //job handles of the jobs that wait for this one to finish (see the after command)
+    std::vector<uint64_t> dependents;
+    //resources used by the processes of the job that were reaped so far
+    struct rusage usage = {};
+    //wait status of the last process of the job to exit, once the job finished
+    int waitStatus = 0;
+    time_t finishTime = 0;
 
 public:
     void setJobId(job_id_t jobId);
@@ -34,6 +50,37 @@ public:
 
     void setProcessId(pid_t processId);
 
+    const std::vector<pid_t> &getProcessIds() const;
+
+    void setProcessIds(const std::vector<pid_t> &processIds);
+
+    /// forget a process of the job that exited
+    /// \return true if the job still has live processes
+    bool removeProcessId(pid_t processId);
+
+    size_t getHeapPosition() const;
+
+    const std::vector<uint64_t> &getDependents() const;
+
+    void addDependent(uint64_t dependent);
+
+    void setDependents(const std::vector<uint64_t> &dependents);
+
+    const struct rusage &getUsage() const;
+
+    /// account for a reaped process of the job: CPU times and context switches add up, max RSS is the largest one
+    void addUsage(const struct rusage &processUsage);
+
+    int getWaitStatus() const;
+
+    time_t getFinishTime() const;
+
+    /// mark the job as finished now
+    /// \param waitStatus wait status of its last process
+    void setFinished(int waitStatus);
+
+    void setHeapPosition(size_t heapPosition);
+
     bool operator<(const ProcessControlBlock &rhs) const;
 
     bool operator>(const ProcessControlBlock &rhs) const;
@@ -52,6 +99,10 @@ public:
 
     bool isRunning() const;
 
+    void setQueued(bool queued);
+
+    bool isQueued() const;
+
     const std::string &getCreatingCommand() const;
 
     ProcessControlBlock(const job_id_t jobId,
@@ -67,16 +118,16 @@ public:
 
 class TimedProcessControlBlock : public ProcessControlBlock {
 private:
-    //ROI - field for timed process
-    time_t abortTime;
+    //ROI - field for timed process, in milliseconds of the monotonic clock
+    uint64_t abortTime;
     bool isBackground = false;
 
 public:
     TimedProcessControlBlock(const job_id_t jobId,
                              const pid_t processId,
-                             const std::string &creatingCommand, int futureSeconds, bool flag = false);
+                             const std::string &creatingCommand, uint64_t abortTime, bool flag = false);
 
-    time_t getAbortTime() const;
+    uint64_t getAbortTime() const;
     bool getIsBackground() const;
 
     bool operator<(const TimedProcessControlBlock &rhs) const;
@@ -0,0 +1,119 @@
+#ifndef OS_HW1_SLAB_H
+#define OS_HW1_SLAB_H
+
+#include <stdint.h>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// Pool of T in fixed-size chunks of slots, reusing freed slots through a free list.
+/// Elements never move, so pointers to them stay valid until they are released, and a handle to a released element is
+/// recognized as stale by its generation. Allocating, releasing and looking up are O(1) and don't allocate except when
+/// a new chunk is needed.
+template<class T>
+class Slab {
+public:
+    typedef uint64_t handle_t;
+    static const handle_t NO_HANDLE = 0;
+
+private:
+    enum { CHUNK_BITS = 6, CHUNK_SIZE = 1 << CHUNK_BITS, CHUNK_MASK = CHUNK_SIZE - 1 };
+    static const uint32_t NO_SLOT = (uint32_t) -1;
+
+    struct Slot {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+        uint32_t generation = 1;
+        uint32_t nextFree = NO_SLOT;
+        bool used = false;
+
+        T *value() {
+            return reinterpret_cast<T *>(&storage);
+        }
+    };
+
+    std::vector<std::unique_ptr<Slot[]> > chunks;
+    uint32_t slotCount = 0;
+    uint32_t firstFree = NO_SLOT;
+    size_t usedCount = 0;
+
+    Slot &slot(uint32_t index) const {
+        return chunks[index >> CHUNK_BITS][index & CHUNK_MASK];
+    }
+
+    /// \return the slot of handle, nullptr if the handle is stale
+    Slot *find(handle_t handle) const {
+        uint64_t index = (handle & 0xffffffff) - 1;
+        if (handle == NO_HANDLE || index >= slotCount) return nullptr;
+        Slot &result = slot(index);
+        if (!result.used || result.generation != (uint32_t) (handle >> 32)) return nullptr;
+        return &result;
+    }
+
+public:
+    Slab() = default;
+    Slab(const Slab &) = delete;
+    Slab &operator=(const Slab &) = delete;
+
+    ~Slab() {
+        clear();
+    }
+
+    /// \return handle of a new element constructed from value
+    handle_t allocate(T value) {
+        uint32_t index = firstFree;
+        if (index == NO_SLOT) {
+            if ((slotCount & CHUNK_MASK) == 0) chunks.push_back(std::unique_ptr<Slot[]>(new Slot[CHUNK_SIZE]));
+            index = slotCount++;
+        } else {
+            firstFree = slot(index).nextFree;
+        }
+
+        Slot &target = slot(index);
+        new(&target.storage) T(std::move(value));
+        target.used = true;
+        ++usedCount;
+        return ((handle_t) target.generation << 32) | (index + 1);
+    }
+
+    /// destroy the element of handle, making every handle to it stale
+    /// \return false if the handle was already stale
+    bool release(handle_t handle) {
+        Slot *target = find(handle);
+        if (!target) return false;
+        target->value()->~T();
+        target->used = false;
+        ++target->generation;
+        target->nextFree = firstFree;
+        firstFree = (handle & 0xffffffff) - 1;
+        --usedCount;
+        return true;
+    }
+
+    /// \return the element of handle, nullptr if the handle is stale
+    T *get(handle_t handle) const {
+        Slot *target = find(handle);
+        return target ? target->value() : nullptr;
+    }
+
+    size_t size() const {
+        return usedCount;
+    }
+
+    bool empty() const {
+        return usedCount == 0;
+    }
+
+    void clear() {
+        for (uint32_t index = 0; index < slotCount; ++index) {
+            Slot &target = slot(index);
+            if (target.used) release(((handle_t) target.generation << 32) | (index + 1));
+        }
+    }
+};
+
+template<class T>
+const typename Slab<T>::handle_t Slab<T>::NO_HANDLE;
+
+#endif //OS_HW1_SLAB_H
@@ -0,0 +1,208 @@
+#ifndef OS_HW1_TIMERWHEEL_H
+#define OS_HW1_TIMERWHEEL_H
+
+#include <stdint.h>
+#include <time.h>
+#include <vector>
+
+/// \return milliseconds on the monotonic clock, the time base of TimerWheel deadlines
+inline uint64_t monotonicMilliseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/// Hierarchical timer wheel with 1 tick resolution.
+/// Level k has 64 slots of 64^k ticks each; a timer sits at the coarsest level whose slot span still fits its
+/// remaining time and moves down a level (cascades) when the wheel reaches its slot.
+/// Scheduling and cancelling are O(1), expiring is O(1) per expired timer plus O(1) per 64 idle ticks.
+template<class T>
+class TimerWheel {
+public:
+    typedef uint64_t handle_t;
+    static const handle_t NO_TIMER = 0;
+
+private:
+    enum { SLOT_BITS = 6, SLOTS = 1 << SLOT_BITS, SLOT_MASK = SLOTS - 1, LEVELS = 4 };
+    static const int32_t NO_NODE = -1;
+
+    struct Node {
+        uint64_t deadline;
+        T payload;
+        uint32_t generation;
+        int32_t previous, next;
+        uint8_t level, slot;
+        bool active;
+
+        Node(uint64_t deadline, const T &payload) : deadline(deadline), payload(payload), generation(1),
+            previous(NO_NODE), next(NO_NODE), level(0), slot(0), active(false) {}
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int32_t> freeNodes;
+    int32_t heads[LEVELS][SLOTS];
+    //bit i of occupied[k] is set iff slot i of level k isn't empty
+    uint64_t occupied[LEVELS];
+    //every tick before current was already expired
+    uint64_t current;
+    size_t activeCount = 0;
+
+    static uint64_t span(int level) {
+        return (uint64_t) 1 << (SLOT_BITS * level);
+    }
+
+    void link(int32_t index) {
+        Node &node = nodes[index];
+        uint64_t delta = (node.deadline > current) ? node.deadline - current : 0;
+        int level = 0;
+        while (level < LEVELS - 1 && delta >= span(level + 1)) ++level;
+        //beyond the wheel's range - park in the last slot reachable and cascade again from there
+        uint64_t target = (delta >= span(LEVELS)) ? current + span(LEVELS) - 1 : current + delta;
+        unsigned slot = (target >> (SLOT_BITS * level)) & SLOT_MASK;
+
+        node.level = level;
+        node.slot = slot;
+        node.previous = NO_NODE;
+        node.next = heads[level][slot];
+        if (node.next != NO_NODE) nodes[node.next].previous = index;
+        heads[level][slot] = index;
+        occupied[level] |= (uint64_t) 1 << slot;
+    }
+
+    void unlink(int32_t index) {
+        Node &node = nodes[index];
+        if (node.previous != NO_NODE) nodes[node.previous].next = node.next;
+        else heads[node.level][node.slot] = node.next;
+        if (node.next != NO_NODE) nodes[node.next].previous = node.previous;
+        if (heads[node.level][node.slot] == NO_NODE) occupied[node.level] &= ~((uint64_t) 1 << node.slot);
+    }
+
+    void release(int32_t index) {
+        nodes[index].active = false;
+        ++nodes[index].generation;
+        freeNodes.push_back(index);
+        --activeCount;
+    }
+
+    /// move the timers of the slot of level the wheel just reached down to finer levels
+    void cascade(int level) {
+        unsigned slot = (current >> (SLOT_BITS * level)) & SLOT_MASK;
+        int32_t index = heads[level][slot];
+        heads[level][slot] = NO_NODE;
+        occupied[level] &= ~((uint64_t) 1 << slot);
+        while (index != NO_NODE) {
+            int32_t next = nodes[index].next;
+            link(index);
+            index = next;
+        }
+    }
+
+    /// \return first tick of the nearest occupied slot of level, searching cyclically from the wheel's current slot
+    /// (or from the one after it)
+    uint64_t nextOccupied(int level, bool includeCurrent) const {
+        const uint64_t position = current >> (SLOT_BITS * level);
+        const unsigned index = position & SLOT_MASK;
+        const uint64_t blockStart = position - index;
+        const unsigned first = includeCurrent ? index : index + 1;
+        uint64_t later = (first >= SLOTS) ? 0 : occupied[level] & (~(uint64_t) 0 << first);
+        uint64_t slotPosition = later ? blockStart + __builtin_ctzll(later)
+                                      : blockStart + SLOTS + __builtin_ctzll(occupied[level]);
+        return slotPosition << (SLOT_BITS * level);
+    }
+
+public:
+    explicit TimerWheel(uint64_t now) : current(now) {
+        for (int level = 0; level < LEVELS; ++level) {
+            occupied[level] = 0;
+            for (int slot = 0; slot < SLOTS; ++slot) heads[level][slot] = NO_NODE;
+        }
+    }
+
+    /// \param deadline tick at which the timer expires (already passed deadlines expire on the next expire call)
+    /// \return handle to cancel the timer with
+    handle_t schedule(uint64_t deadline, const T &payload) {
+        int32_t index;
+        if (!freeNodes.empty()) {
+            index = freeNodes.back();
+            freeNodes.pop_back();
+            nodes[index].deadline = deadline;
+            nodes[index].payload = payload;
+        } else {
+            index = nodes.size();
+            nodes.push_back(Node(deadline, payload));
+        }
+        nodes[index].active = true;
+        ++activeCount;
+        link(index);
+        return ((handle_t) nodes[index].generation << 32) | (uint32_t) (index + 1);
+    }
+
+    /// \return false if the timer already expired or was cancelled
+    bool cancel(handle_t handle) {
+        int64_t index = (int64_t) (handle & 0xffffffff) - 1;
+        if (index < 0 || index >= (int64_t) nodes.size()) return false;
+        Node &node = nodes[index];
+        if (!node.active || node.generation != (uint32_t) (handle >> 32)) return false;
+        unlink(index);
+        release(index);
+        return true;
+    }
+
+    /// advance the wheel to now, appending the payload of every timer due by then to expired (earliest first)
+    void expire(uint64_t now, std::vector<T> &expired) {
+        while (current <= now) {
+            const unsigned index = current & SLOT_MASK;
+            //entering a new block of a level - cascade the matching slot of the level above
+            for (int level = 1; level < LEVELS; ++level) {
+                if ((current & (span(level) - 1)) != 0) break;
+                cascade(level);
+            }
+
+            int32_t node = heads[0][index];
+            heads[0][index] = NO_NODE;
+            occupied[0] &= ~((uint64_t) 1 << index);
+            while (node != NO_NODE) {
+                int32_t next = nodes[node].next;
+                expired.push_back(nodes[node].payload);
+                release(node);
+                node = next;
+            }
+
+            //skip straight to the next occupied tick of this block, or to the block's end
+            uint64_t later = (index == SLOT_MASK) ? 0 : occupied[0] & (~(uint64_t) 0 << (index + 1));
+            uint64_t next = later ? current - index + __builtin_ctzll(later) : (current | SLOT_MASK) + 1;
+            current = (next > now + 1) ? now + 1 : next;
+        }
+    }
+
+    /// \return earliest tick at which expire may have work to do (a deadline or a cascade), UINT64_MAX if none
+    uint64_t nextWakeup() const {
+        if (!activeCount) return UINT64_MAX;
+        uint64_t wakeup = occupied[0] ? nextOccupied(0, true) : UINT64_MAX;
+        for (int level = 1; level < LEVELS; ++level) {
+            if (!occupied[level]) continue;
+            //a slot is cascaded when the wheel enters it, so the current slot still counts only before that
+            uint64_t candidate = nextOccupied(level, (current & (span(level) - 1)) == 0);
+            if (candidate < wakeup) wakeup = candidate;
+        }
+        return wakeup;
+    }
+
+    size_t size() const {
+        return activeCount;
+    }
+
+    bool empty() const {
+        return activeCount == 0;
+    }
+
+    void clear() {
+        for (size_t index = 0; index < nodes.size(); ++index) {
+            if (!nodes[index].active) continue;
+            unlink(index);
+            release(index);
+        }
+    }
+};
+
+#endif //OS_HW1_TIMERWHEEL_H
@@ -0,0 +1,102 @@
+#include "Tracer.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include "Commands.h"
+
+bool Tracer::enabled = false;
+Tracer::Ring *Tracer::ring = nullptr;
+uint64_t Tracer::sonStart = 0;
+
+static const char *const PHASE_NAMES[TRACE_PHASE_COUNT] = {
+        "line", "parse", "fork", "spawn", "exec", "waitpid", "redirection", "removeFinishedJobs"
+};
+
+uint64_t Tracer::now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64_t) time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+void Tracer::record(TracePhase phase, uint64_t start, uint64_t end, std::string_view label) {
+    const uint64_t index = ring->next.fetch_add(1, std::memory_order_relaxed);
+    Slot &slot = ring->slots[index % CAPACITY];
+    slot.sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.event.start = start;
+    slot.event.duration = end - start;
+    slot.event.pid = getpid();
+    slot.event.phase = phase;
+    const size_t labelLength = std::min(label.length(), sizeof(slot.event.label) - 1);
+    memcpy(slot.event.label, label.data(), labelLength);
+    slot.event.label[labelLength] = '\0';
+
+    slot.sequence.store(2 * (index + 1), std::memory_order_release);
+}
+
+void Tracer::start() {
+    if (!ring) {
+        //shared, so that sons record into it as well
+        void *mapping = mmap(nullptr, sizeof(Ring), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED) throw SmashExceptions::SyscallException("mmap");
+        ring = static_cast<Ring *>(mapping); //zero filled, which is a valid empty ring
+    } else {
+        ring->next.store(0, std::memory_order_relaxed);
+        for (Slot &slot : ring->slots) slot.sequence.store(0, std::memory_order_relaxed);
+    }
+    enabled = true;
+}
+
+void Tracer::stop() {
+    enabled = false;
+}
+
+bool Tracer::isEnabled() {
+    return enabled;
+}
+
+/// append text to out as the contents of a JSON string
+static void _appendJsonString(std::string &out, const char *text) {
+    for (; *text; ++text) {
+        if (*text == '"' || *text == '\\') out += '\\';
+        if ((unsigned char) *text < ' ') out += ' ';
+        else out += *text;
+    }
+}
+
+void Tracer::dump(const std::string &fileName) {
+    FILE *file = fopen(fileName.c_str(), "w");
+    if (!file) throw SmashExceptions::SyscallException("fopen");
+
+    const pid_t smashPid = getpid();
+    fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+    bool first = true;
+    const uint64_t next = ring ? ring->next.load(std::memory_order_acquire) : 0;
+    for (uint64_t index = (next > CAPACITY) ? next - CAPACITY : 0; index < next; ++index) {
+        const Slot &slot = ring->slots[index % CAPACITY];
+        //a copy that wasn't overwritten while it was taken
+        if (slot.sequence.load(std::memory_order_acquire) != 2 * (index + 1)) continue;
+        const TraceEvent event = slot.event;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != 2 * (index + 1)) continue;
+
+        std::string args;
+        if (event.label[0]) {
+            args = ", \"args\": {\"command\": \"";
+            _appendJsonString(args, event.label);
+            args += "\"}";
+        }
+        //sons show up as threads of smash
+        fprintf(file, "%s{\"name\": \"%s\", \"cat\": \"smash\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+                      "\"pid\": %d, \"tid\": %d%s}",
+                first ? "" : ",\n", PHASE_NAMES[event.phase], event.start / 1000.0, event.duration / 1000.0,
+                smashPid, event.pid, args.c_str());
+        first = false;
+    }
+    fprintf(file, "\n]}\n");
+    if (fclose(file) != 0) throw SmashExceptions::SyscallException("fclose");
+}
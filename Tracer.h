@@ -0,0 +1,94 @@
+#ifndef OS_HW1_TRACER_H
+#define OS_HW1_TRACER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <atomic>
+#include <string>
+#include <string_view>
+
+/// Phases of running a command line that are timed while tracing is on
+enum TracePhase {
+    TRACE_LINE, //the whole command line, from executeCommand until the prompt is back
+    TRACE_PARSE, //CreateCommand - parsing and constructing the commands
+    TRACE_FORK,
+    TRACE_SPAWN, //posix_spawn - fork and exec together
+    TRACE_EXEC, //in the son, from fork until it calls exec
+    TRACE_WAIT, //blocked in waitpid
+    TRACE_REDIRECTION, //opening files and moving file descriptors for '>' and '|'
+    TRACE_REMOVE_FINISHED_JOBS,
+    TRACE_PHASE_COUNT
+};
+
+struct TraceEvent {
+    uint64_t start; //CLOCK_MONOTONIC nanoseconds
+    uint64_t duration;
+    pid_t pid; //process that recorded the event - smash, or a son before it execs
+    TracePhase phase;
+    char label[40]; //start of the command line, TRACE_LINE only
+};
+
+/// Records phase timings into a fixed-size ring, keeping the newest events. The ring is a shared mapping, so sons
+/// forked while tracing record into the same ring until they exec. Writers claim a slot with a single fetch_add and
+/// publish it with a sequence number, without ever taking a lock.
+/// When tracing is off, every probe costs one branch on a flag that is almost always false.
+class Tracer {
+private:
+    static const size_t CAPACITY = 16384;
+
+    struct Slot {
+        //2 * (index + 1) once the event of that index is complete, odd while it is written
+        std::atomic<uint64_t> sequence;
+        TraceEvent event;
+    };
+
+    struct Ring {
+        std::atomic<uint64_t> next;
+        Slot slots[CAPACITY];
+    };
+
+    static bool enabled;
+    static Ring *ring;
+
+    static uint64_t now();
+    static void record(TracePhase phase, uint64_t start, uint64_t end, std::string_view label);
+
+public:
+    //start of a forked son, for its TRACE_EXEC event
+    static uint64_t sonStart;
+
+    /// \return start time of a phase, 0 when tracing is off
+    static uint64_t begin() {
+        if (__builtin_expect(enabled, false)) return now();
+        return 0;
+    }
+
+    /// record a phase that began at start (as returned by begin) and ends now
+    static void end(TracePhase phase, uint64_t start, std::string_view label = std::string_view()) {
+        if (__builtin_expect(start != 0, false)) record(phase, start, now(), label);
+    }
+
+    /// turn tracing on, dropping the events recorded so far
+    static void start();
+    static void stop();
+    static bool isEnabled();
+
+    /// write the recorded events in Chrome's trace event format (chrome://tracing, Perfetto)
+    static void dump(const std::string &fileName);
+};
+
+/// times the enclosing scope as the given phase
+class TraceScope {
+private:
+    const TracePhase phase;
+    const uint64_t start;
+
+public:
+    explicit TraceScope(TracePhase phase) : phase(phase), start(Tracer::begin()) {}
+    TraceScope(const TraceScope &) = delete;
+    TraceScope &operator=(const TraceScope &) = delete;
+    ~TraceScope() { Tracer::end(phase, start); }
+};
+
+#endif //OS_HW1_TRACER_H
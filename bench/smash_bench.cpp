@@ -0,0 +1,333 @@
+//
+// Benchmark suite of smash. Commands run in-process through SmallShell::executeCommand, as they do behind the prompt,
+// with their output sent to /dev/null. The results are printed to stdout as one JSON document, so that runs of
+// different releases can be compared.
+//
+// usage: smash_bench [--max-size MB]    files larger than MB (1024 by default) are skipped
+//
+
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../Commands.h"
+
+using std::string;
+
+struct Result {
+    string name;
+    //JSON members describing the case, e.g. "\"jobs\": 10"
+    string parameters;
+    long iterations;
+    string unit;
+    double value;
+};
+
+std::vector<Result> results;
+
+const size_t MEGABYTE = 1024 * 1024;
+
+double _secondsSince(std::chrono::steady_clock::time_point start) {
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/// \return CPU time smash used so far, in seconds
+double _cpuSeconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+string _jsonString(const string &text) {
+    string result = "\"";
+    for (char character : text) {
+        if (character == '"' || character == '\\') result += '\\';
+        result += character;
+    }
+    return result + "\"";
+}
+
+void _record(const string &name, const string &parameters, long iterations, const string &unit, double value) {
+    results.push_back(Result{name, parameters, iterations, unit, value});
+    fprintf(stderr, "%-24s %-40s %14.3f %s\n", name.c_str(), parameters.c_str(), value, unit.c_str());
+}
+
+/// sends stdout to /dev/null while it exists, so the output of the commands doesn't get mixed into the results
+class QuietStdout {
+private:
+    int stdoutCopy;
+
+public:
+    QuietStdout() {
+        std::cout.flush();
+        fflush(stdout);
+        stdoutCopy = dup(STDOUT_FILENO);
+        int devNull = open("/dev/null", O_WRONLY);
+        dup2(devNull, STDOUT_FILENO);
+        close(devNull);
+    }
+
+    ~QuietStdout() {
+        std::cout.flush();
+        fflush(stdout);
+        dup2(stdoutCopy, STDOUT_FILENO);
+        close(stdoutCopy);
+    }
+};
+
+/// fork a son leading a process group of its own, as the son of a job would, that only waits for signals
+/// \param stopped stop the son before returning
+/// \param exitOnContinue the son exits as soon as it is continued (a stopped son only)
+pid_t _forkIdleSon(bool stopped, bool exitOnContinue = false) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        exit(1);
+    }
+    if (pid == 0) {
+        setpgid(0, 0);
+        if (stopped) raise(SIGSTOP);
+        if (exitOnContinue) _exit(0);
+        while (true) pause();
+    }
+    setpgid(pid, pid);
+    if (stopped) {
+        int status;
+        waitpid(pid, &status, WUNTRACED);
+    }
+    return pid;
+}
+
+void _addIdleJobs(SmallShell &smash, size_t count, bool stopped, bool exitOnContinue = false) {
+    for (size_t job = 0; job < count; ++job) {
+        ProcessControlBlock pcb = ProcessControlBlock(-1, _forkIdleSon(stopped, exitOnContinue), "sleep 1000 &");
+        pcb.setRunning(!stopped);
+        smash.jobs.addJob(pcb);
+    }
+}
+
+/// kill every job and wait until all of them were reaped
+void _clearJobs(SmallShell &smash) {
+    {
+        QuietStdout quiet;
+        smash.jobs.killAllJobs();
+    }
+    while (true) {
+        smash.jobs.removeFinishedJobs();
+        if (smash.jobs.isEmpty()) return;
+        smash.jobs.waitChildStateChange();
+    }
+}
+
+void _benchBuiltinDispatch(SmallShell &smash) {
+    const long iterations = 100000;
+    for (const char *command : {"showpid", "pwd", "chprompt"}) {
+        QuietStdout quiet;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (long i = 0; i < iterations; ++i) smash.executeCommand(command);
+        const double seconds = _secondsSince(start);
+        _record("builtin_dispatch", "\"command\": " + _jsonString(command), iterations, "ns/op", seconds * 1e9 / iterations);
+    }
+}
+
+void _benchExternalCommand(SmallShell &smash) {
+    const long iterations = 300;
+    for (const char *backend : {"fork", "spawn"}) {
+        smash.executeCommand(string("launch ") + backend);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (long i = 0; i < iterations; ++i) smash.executeCommand("/bin/true");
+        const double seconds = _secondsSince(start);
+        _record("external_spawn_to_exit", "\"backend\": " + _jsonString(backend), iterations, "us/op",
+                seconds * 1e6 / iterations);
+    }
+    smash.executeCommand("launch fork");
+}
+
+void _benchPipe(SmallShell &smash, size_t maxSize) {
+    const size_t size = std::min<size_t>(256 * MEGABYTE, maxSize);
+    const string command = "head -c " + std::to_string(size) + " /dev/zero | cat";
+    QuietStdout quiet;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    smash.executeCommand(command);
+    const double seconds = _secondsSince(start);
+    _record("pipe_throughput", "\"bytes\": " + std::to_string(size), 1, "MB/s", size / seconds / MEGABYTE);
+}
+
+/// write a file of size bytes that is not sparse, so copying it really moves the data
+void _createFile(const string &path, size_t size) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror("open");
+        exit(1);
+    }
+    std::vector<char> block(MEGABYTE);
+    for (size_t i = 0; i < block.size(); ++i) block[i] = (char) (i * 31 + 7);
+    for (size_t written = 0; written < size;) {
+        ssize_t result = write(fd, block.data(), std::min(block.size(), size - written));
+        if (result < 0) {
+            perror("write");
+            exit(1);
+        }
+        written += result;
+    }
+    close(fd);
+}
+
+void _benchFileCopies(SmallShell &smash, const string &directory, size_t maxSize) {
+    const string source = directory + "/source", target = directory + "/target";
+    for (size_t megabytes : {1, 100, 1024}) {
+        const size_t size = megabytes * MEGABYTE;
+        if (size > maxSize) continue;
+        _createFile(source, size);
+        //small files are copied several times, so that the result is more than noise
+        const long iterations = std::max<long>(1, 100 / megabytes);
+
+        const string redirection = "cat " + source + " > " + target;
+        const string copy = "cp " + source + " " + target;
+        for (const string *command : {&redirection, &copy}) {
+            QuietStdout quiet;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (long i = 0; i < iterations; ++i) smash.executeCommand(*command);
+            const double seconds = _secondsSince(start);
+            _record((command == &copy) ? "cp_throughput" : "redirection_throughput",
+                    "\"bytes\": " + std::to_string(size), iterations, "MB/s", size * iterations / seconds / MEGABYTE);
+        }
+        unlink(target.c_str());
+    }
+    unlink(source.c_str());
+}
+
+void _benchJobs(SmallShell &smash) {
+    for (size_t jobCount : {10, 1000, 10000}) {
+        _addIdleJobs(smash, jobCount, false);
+        const string parameters = "\"jobs\": " + std::to_string(jobCount);
+
+        const long listIterations = std::max<long>(5, 100000 / jobCount);
+        {
+            QuietStdout quiet;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (long i = 0; i < listIterations; ++i) smash.executeCommand("jobs");
+            _record("jobs_list", parameters, listIterations, "us/op", _secondsSince(start) * 1e6 / listIterations);
+        }
+
+        //the same list, printed by a builtin stage into a pipe
+        const long pipeIterations = std::max<long>(5, 10000 / jobCount);
+        {
+            QuietStdout quiet;
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (long i = 0; i < pipeIterations; ++i) smash.executeCommand("jobs | cat");
+            _record("jobs_pipe", parameters, pipeIterations, "us/op", _secondsSince(start) * 1e6 / pipeIterations);
+        }
+
+        //no job changed state - the common case before every line
+        smash.jobs.removeFinishedJobs();
+        const long idleIterations = 1000000;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (long i = 0; i < idleIterations; ++i) smash.jobs.removeFinishedJobs();
+        _record("remove_finished_jobs_idle", parameters, idleIterations, "ns/op",
+                _secondsSince(start) * 1e9 / idleIterations);
+
+        //the newest 10 jobs exited
+        const long exited = std::min<long>(10, jobCount);
+        for (job_id_t jobId = jobCount; jobId > (job_id_t) (jobCount - exited); --jobId) {
+            ProcessControlBlock *pcb = smash.jobs.getJobById(jobId);
+            kill(pcb->getProcessId(), SIGKILL);
+            //wait until it is a zombie, so that removeFinishedJobs finds it right away
+            siginfo_t childInfo;
+            waitid(P_PID, pcb->getProcessId(), &childInfo, WEXITED | WNOWAIT);
+        }
+        JobsManager::childStateChanged = true;
+        start = std::chrono::steady_clock::now();
+        smash.jobs.removeFinishedJobs();
+        _record("remove_finished_jobs_10_exited", parameters, 1, "us/op", _secondsSince(start) * 1e6);
+
+        //quit kill, without the exit. Wall time includes the killed sons exiting, when they share smash's CPUs
+        {
+            QuietStdout quiet;
+            const double cpuStart = _cpuSeconds();
+            start = std::chrono::steady_clock::now();
+            smash.jobs.killAllJobs();
+            const double seconds = _secondsSince(start);
+            _record("kill_all_jobs", parameters, 1, "us/op", seconds * 1e6);
+            _record("kill_all_jobs_cpu", parameters, 1, "us/op", (_cpuSeconds() - cpuStart) * 1e6);
+        }
+        _clearJobs(smash);
+    }
+}
+
+void _benchBackgroundForeground(SmallShell &smash) {
+    const size_t stoppedJobs = 1000;
+    const long iterations = 200;
+    _addIdleJobs(smash, stoppedJobs, true);
+    const string parameters = "\"stopped_jobs\": " + std::to_string(stoppedJobs);
+
+    //bg resumes the last stopped job, which is stopped again outside the measurement
+    double seconds = 0;
+    for (long i = 0; i < iterations; ++i) {
+        QuietStdout quiet;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        smash.executeCommand("bg");
+        seconds += _secondsSince(start);
+        smash.executeCommand("kill -19 " + std::to_string(stoppedJobs));
+    }
+    _record("bg_latency", parameters, iterations, "us/op", seconds * 1e6 / iterations);
+
+    //fg continues a stopped job that exits right away, until it was reaped
+    _addIdleJobs(smash, iterations, true, true);
+    seconds = 0;
+    for (long i = 0; i < iterations; ++i) {
+        QuietStdout quiet;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        smash.executeCommand("fg " + std::to_string(stoppedJobs + i + 1));
+        seconds += _secondsSince(start);
+    }
+    _record("fg_latency", parameters, iterations, "us/op", seconds * 1e6 / iterations);
+
+    _clearJobs(smash);
+}
+
+int main(int argc, char *argv[]) {
+    size_t maxSize = 1024 * MEGABYTE;
+    if (argc == 3 && !strcmp(argv[1], "--max-size")) maxSize = strtoull(argv[2], nullptr, 10) * MEGABYTE;
+    else if (argc != 1) {
+        fprintf(stderr, "usage: %s [--max-size MB]\n", argv[0]);
+        return 1;
+    }
+
+    char directory[] = "/tmp/smash_bench.XXXXXX";
+    if (!mkdtemp(directory)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    SmallShell &smash = SmallShell::getInstance();
+    //child state changes are read from the signal fd, as they are behind the prompt
+    smash.watchSignals();
+    _benchBuiltinDispatch(smash);
+    _benchExternalCommand(smash);
+    _benchPipe(smash, maxSize);
+    _benchFileCopies(smash, directory, maxSize);
+    _benchJobs(smash);
+    _benchBackgroundForeground(smash);
+    rmdir(directory);
+
+    printf("{\n  \"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result &result = results[i];
+        printf("    {\"name\": %s, %s, \"iterations\": %ld, \"unit\": %s, \"value\": %.3f}%s\n",
+               _jsonString(result.name).c_str(), result.parameters.c_str(), result.iterations,
+               _jsonString(result.unit).c_str(), result.value, (i + 1 < results.size()) ? "," : "");
+    }
+    printf("  ]\n}\n");
+    return 0;
+}
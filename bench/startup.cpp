@@ -0,0 +1,105 @@
+//
+// Startup-latency benchmark: how long it takes to start a shell, run one command line and get its exit status back.
+// Compares `smash -c` against `bash -c` and against smash reading the same line (followed by quit) from stdin.
+//
+// usage: startup_bench <smash binary> [command line] [runs]
+//
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+extern char **environ;
+
+struct Variant {
+    const char *name;
+    std::vector<std::string> argv;
+    //fed to the stdin of the shell, nothing if empty (stdin is /dev/null then)
+    std::string input;
+};
+
+/// spawn the variant once and wait for it
+/// \return microseconds from spawn until the shell was reaped, negative on failure
+double _runOnce(const Variant &variant, int devNull) {
+    int inputPipe[2] = {-1, -1};
+    posix_spawn_file_actions_t fileActions;
+    posix_spawn_file_actions_init(&fileActions);
+    if (!variant.input.empty()) {
+        if (pipe2(inputPipe, O_CLOEXEC) < 0) return -1;
+        posix_spawn_file_actions_adddup2(&fileActions, inputPipe[0], STDIN_FILENO);
+    } else posix_spawn_file_actions_adddup2(&fileActions, devNull, STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&fileActions, devNull, STDOUT_FILENO);
+
+    std::vector<char *> argv;
+    for (const std::string &arg : variant.argv) argv.push_back(const_cast<char *>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    pid_t pid;
+    int spawnStatus = posix_spawn(&pid, argv[0], &fileActions, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&fileActions);
+    if (!variant.input.empty()) {
+        close(inputPipe[0]);
+        if (spawnStatus == 0) {
+            //a few bytes, well within the pipe buffer
+            if (write(inputPipe[1], variant.input.data(), variant.input.size()) < 0) perror("write");
+        }
+        close(inputPipe[1]);
+    }
+    if (spawnStatus != 0) return -1;
+
+    int status;
+    if (waitpid(pid, &status, 0) < 0) return -1;
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <smash binary> [command line] [runs]\n", argv[0]);
+        return 1;
+    }
+    const std::string smash = argv[1];
+    const std::string commandLine = (argc > 2) ? argv[2] : "true";
+    const int runs = (argc > 3) ? atoi(argv[3]) : 500;
+
+    const Variant variants[] = {
+            {"bash -c", {"/bin/bash", "-c", commandLine}, ""},
+            {"smash stdin", {smash}, commandLine + "\nquit\n"},
+            {"smash -c", {smash, "-c", commandLine}, ""},
+    };
+
+    int devNull = open("/dev/null", O_RDWR | O_CLOEXEC);
+    if (devNull < 0) {
+        perror("open");
+        return 1;
+    }
+
+    printf("command line: %s, %d runs\n", commandLine.c_str(), runs);
+    printf("%-12s %12s %12s %12s\n", "shell", "mean us", "median us", "p99 us");
+    for (const Variant &variant : variants) {
+        std::vector<double> samples;
+        for (int run = 0; run < runs; ++run) {
+            double sample = _runOnce(variant, devNull);
+            if (sample < 0) {
+                perror(variant.name);
+                return 1;
+            }
+            samples.push_back(sample);
+        }
+        std::sort(samples.begin(), samples.end());
+        double total = 0;
+        for (double sample : samples) total += sample;
+        printf("%-12s %12.1f %12.1f %12.1f\n", variant.name, total / runs, samples[runs / 2],
+               samples[std::min<size_t>(runs - 1, runs * 99 / 100)]);
+    }
+    return 0;
+}
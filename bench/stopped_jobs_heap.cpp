@@ -0,0 +1,111 @@
+//
+// Micro-benchmark of the heap of stopped jobs: the IndexedHeap JobsManager uses against the vector-backed Heap it
+// replaced. Each stopped job goes through the operations of ctrl-Z (insert), bg (top, then erase) and
+// bg/fg/kill of a given job (erase of an arbitrary job).
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "../Commands.h"
+
+/// the heap of stopped jobs as it was before IndexedHeap, kept here for comparison
+template<class T>
+class Heap : private std::vector<T> {
+public:
+    T getMax() {
+        T result = this->front();
+        for (T elem : *this) if (*elem > *result) result = elem;
+        return result;
+    }
+
+    void insert(T &newElement) {
+        std::vector<T>::push_back(newElement);
+        push_heap(this->begin(), this->end());
+    }
+
+    void erase(const T &target) {
+        typename std::vector<T>::iterator position = find(this->begin(), this->end(), target);
+        if (position != this->end()) std::vector<T>::erase(position);
+        make_heap(this->begin(), this->end());
+    }
+
+    bool empty() {
+        return std::vector<T>::empty();
+    }
+};
+
+typedef IndexedHeap<ProcessControlBlock*, StoppedJobPosition, JobIdOrder> StoppedJobsHeap;
+
+//operations timed per heap size, on top of the initial fill
+const int OPERATIONS = 2000;
+
+struct Result {
+    double insertNs;
+    double bgNs;
+    double eraseNs;
+};
+
+double _nanosecondsSince(std::chrono::steady_clock::time_point start, int operations) {
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / operations;
+}
+
+/// insert every job, then alternate bg (the last stopped job resumes and is stopped again) and removal of a random
+/// job (which is stopped again too, so the heap keeps its size)
+template<class HeapT, class TopF>
+Result _run(HeapT &heap, std::vector<ProcessControlBlock*> &jobs, TopF top, unsigned seed) {
+    std::mt19937 random(seed);
+    Result result;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (ProcessControlBlock *job : jobs) heap.insert(job);
+    result.insertNs = _nanosecondsSince(start, jobs.size());
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < OPERATIONS; ++i) {
+        ProcessControlBlock *last = top(heap);
+        heap.erase(last);
+        heap.insert(last);
+    }
+    result.bgNs = _nanosecondsSince(start, OPERATIONS);
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < OPERATIONS; ++i) {
+        ProcessControlBlock *job = jobs[random() % jobs.size()];
+        heap.erase(job);
+        heap.insert(job);
+    }
+    result.eraseNs = _nanosecondsSince(start, OPERATIONS);
+    return result;
+}
+
+int main() {
+    const size_t sizes[] = {10000, 100000};
+    printf("%-8s %-8s %14s %14s %14s\n", "jobs", "heap", "insert ns/op", "bg ns/op", "erase ns/op");
+    for (size_t size : sizes) {
+        std::vector<ProcessControlBlock> pcbs;
+        pcbs.reserve(size);
+        for (size_t jobId = 1; jobId <= size; ++jobId) {
+            pcbs.push_back(ProcessControlBlock(jobId, jobId + 1000, "sleep 100"));
+        }
+        //jobs are stopped in no particular order of job id
+        std::vector<ProcessControlBlock*> jobs;
+        for (ProcessControlBlock &pcb : pcbs) jobs.push_back(&pcb);
+        std::shuffle(jobs.begin(), jobs.end(), std::mt19937(size));
+
+        Heap<ProcessControlBlock*> legacy;
+        Result legacyResult = _run(legacy, jobs, [](Heap<ProcessControlBlock*> &heap) { return heap.getMax(); }, 1);
+        StoppedJobsHeap indexed;
+        Result indexedResult = _run(indexed, jobs, [](StoppedJobsHeap &heap) { return heap.top(); }, 1);
+
+        printf("%-8zu %-8s %14.1f %14.1f %14.1f\n", size, "legacy",
+               legacyResult.insertNs, legacyResult.bgNs, legacyResult.eraseNs);
+        printf("%-8zu %-8s %14.1f %14.1f %14.1f\n", size, "indexed",
+               indexedResult.insertNs, indexedResult.bgNs, indexedResult.eraseNs);
+    }
+    return 0;
+}
@@ -3,6 +3,14 @@
 #include <stdio.h>
 #include <sys/wait.h>
 #include <signal.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <ctype.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <vector>
 #include "Commands.h"
 
 #define DEBUG_PRINT(err_msg) /*cerr << "DEBUG: " << err_msg */
@@ -11,109 +19,206 @@ using namespace std;
 
 SmallShell* shell = nullptr;
 
-namespace SignalHandlers {
-    void ctrlZHandler(int sig_num) {
-        cout << "smash: got ctrl-Z" << endl;
+//wall time of every line of the script, reported at exit when requested
+std::vector<uint64_t> lineTimes;
+uint64_t scriptStartTime = 0;
+
+/// reap the jobs that changed state since the last line and launch queued jobs in the slots they freed. Once the event
+/// fds exist, this costs a non-blocking epoll_wait per line to read pending signals; jobs are only waited for after a
+/// SIGCHLD was read
+/// \param waitQueued wait until every queued job was launched, before smash exits
+void _sweepJobs(SmallShell& smash, bool waitQueued = false) {
+    try{
+        //SIGCHLD is only noticed once it is read from the signal fd
+        smash.pollEvents();
+        smash.jobs.removeFinishedJobs();
+        smash.jobs.startQueuedJobs();
+        if (waitQueued) smash.jobs.waitQueuedJobs();
+    }
+    catch (SmashExceptions::SameFileException& e) {
+        cout << e.what() << endl;
+    }
+    catch (SmashExceptions::SyscallException& error){
+        std::perror(error.what());
+        fflush(stderr);
+    }
+    catch (SmashExceptions::Exception &error) {
+        cerr << error.what() << endl;
+        cerr.flush();
+    }
+}
 
-        //send SIGSTOP to foreground process
-        const ProcessControlBlock *foregroundProcess = shell->getForegroundProcess();
-        if (foregroundProcess) {
+/// sweep jobs as soon as they change state, while smash waits for its next line
+void _sweepIdleJobs(SmallShell& smash) {
+    _sweepJobs(smash);
+}
 
-            //stop process
-            try{
-                ::sendSignal(*foregroundProcess, SIGSTOP);
-            } catch (SmashExceptions::SyscallException& error){
-                cerr << error.what() << endl;
+/// expand a !prefix line into the latest history entry starting with prefix (!! being the last entry), echoing the
+/// line it expands to like other shells do, and add the line to the history
+/// \return false if the line should be skipped, as there is no entry to expand it into
+bool _recordLine(SmallShell& smash, std::string& cmd_line) {
+    try {
+        const size_t start = cmd_line.find_first_not_of(" \t");
+        if (start != std::string::npos && cmd_line[start] == '!' && start + 1 < cmd_line.length() &&
+            !isspace((unsigned char) cmd_line[start + 1])) {
+            const size_t end = cmd_line.find_last_not_of(" \t\r") + 1;
+            const std::string prefix = cmd_line.substr(start + 1, end - start - 1);
+            if (!smash.history.findPrefix(prefix, cmd_line)) {
+                cerr << "smash error: !" << prefix << ": event not found" << endl;
+                return false;
             }
-
-            cout << "smash: process " << foregroundProcess->getProcessId() << " was stopped" << endl;
-
-            //log that process is stopped
-            const_cast<ProcessControlBlock*>(foregroundProcess)->setRunning(false);
-
-            //add foreground command to jobs
-            shell->jobs.addJob(*foregroundProcess);
+            cout << cmd_line << endl;
         }
+        smash.history.addRecord(cmd_line);
+    }
+    catch (SmashExceptions::SyscallException& error){
+        std::perror(error.what());
+        fflush(stderr);
     }
+    catch (SmashExceptions::Exception &error) {
+        cerr << error.what() << endl;
+        cerr.flush();
+    }
+    return true;
+}
 
-    void ctrlCHandler(int sig_num) {
-        cout << "smash: got ctrl-C" << endl;
+uint64_t _monotonicNanoseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
 
-        //send SIGKILL to foreground process
-        const ProcessControlBlock *foregroundProcess = shell->getForegroundProcess();
-        if (foregroundProcess) {
-            try{
-                ::sendSignal(*foregroundProcess, SIGKILL);
-            } catch (SmashExceptions::SyscallException& error){
-                cerr << error.what() << endl;
+/// atexit handler of a timed script, which also runs when the script quits
+void _printLineTimes() {
+    if (!shell || getpid() != shell->smashPid) return; //sons exit through here too
+    const uint64_t total = _monotonicNanoseconds() - scriptStartTime;
+    fprintf(stderr, "smash: %zu lines in %.3f ms\n", lineTimes.size(), total / 1e6);
+    for (size_t line = 0; line < lineTimes.size(); ++line) {
+        fprintf(stderr, "line %zu: %.3f us\n", line + 1, lineTimes[line] / 1e3);
+    }
+}
+
+/// run every line of a script file, without prompts. A regular file is mapped rather than read, and lines are handed
+/// to executeCommand in place; anything else (a pipe, /dev/stdin) is read whole first. Blank lines and comment lines
+/// are skipped
+/// \param reportTimes print the wall time of the script and of each of its lines at exit
+/// \return exit status of smash
+int _runScript(SmallShell& smash, const char* scriptPath, bool reportTimes) {
+    int scriptFd = open(scriptPath, O_RDONLY);
+    if (scriptFd < 0) {
+        perror("smash error: open failed");
+        return 1;
+    }
+    struct stat scriptStat;
+    if (fstat(scriptFd, &scriptStat) < 0) {
+        perror("smash error: fstat failed");
+        close(scriptFd);
+        return 1;
+    }
+    //a script that can't be mapped, which has no size to go by either
+    std::string scriptBuffer;
+    if (!S_ISREG(scriptStat.st_mode)) {
+        char chunk[65536];
+        ssize_t bytesRead;
+        while ((bytesRead = read(scriptFd, chunk, sizeof(chunk))) != 0) {
+            if (bytesRead < 0) {
+                if (errno == EINTR) continue;
+                perror("smash error: read failed");
+                close(scriptFd);
+                return 1;
             }
-            cout << "smash: process " << foregroundProcess->getProcessId() << " was killed" << endl;
+            scriptBuffer.append(chunk, bytesRead);
+        }
+    }
+    const size_t scriptSize = S_ISREG(scriptStat.st_mode) ? scriptStat.st_size : scriptBuffer.length();
+    const char* script = scriptBuffer.data();
+    if (S_ISREG(scriptStat.st_mode) && scriptSize > 0) {
+        void* mapping = mmap(nullptr, scriptSize, PROT_READ, MAP_PRIVATE, scriptFd, 0);
+        if (mapping == MAP_FAILED) {
+            perror("smash error: mmap failed");
+            close(scriptFd);
+            return 1;
         }
+        madvise(mapping, scriptSize, MADV_SEQUENTIAL);
+        script = static_cast<const char*>(mapping);
     }
+    close(scriptFd);
 
-    void alarmHandler(int sig_num) {
+    if (reportTimes) {
+        scriptStartTime = _monotonicNanoseconds();
+        atexit(_printLineTimes);
+    }
 
-        // do we need to print we got an alarm anyway? - we do
-        cout << "smash: got an alarm" << endl;
-        TimedProcessControlBlock *lateProcess = shell->getLateProcess();
+    const char* const scriptEnd = script + scriptSize;
+    for (const char* lineStart = script; lineStart < scriptEnd;) {
+        const char* newline = static_cast<const char*>(memchr(lineStart, '\n', scriptEnd - lineStart));
+        const char* lineEnd = newline ? newline : scriptEnd;
+        std::string_view cmd_line(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
 
-        //send SIGKILL
-        // i marked built-in command with " " as their command line
-        if (lateProcess) {
-            cout << "smash: " << lateProcess->getCreatingCommand() << " timed out!" << endl;
-        }
+        const size_t firstCharacter = cmd_line.find_first_not_of(" \t\r");
+        if (firstCharacter == std::string_view::npos || cmd_line[firstCharacter] == '#') continue;
+        if (cmd_line.back() == '\r') cmd_line.remove_suffix(1);
 
-        // general remove from job list
-        shell->RemoveLateProcesses();
-        //set signal alarm for next process in the list
-        shell->jobs.setAlarmSignal();
+        const uint64_t lineStartTime = reportTimes ? _monotonicNanoseconds() : 0;
+        _sweepJobs(smash);
+        smash.executeCommand(cmd_line);
+        if (reportTimes) lineTimes.push_back(_monotonicNanoseconds() - lineStartTime);
     }
+
+    if (S_ISREG(scriptStat.st_mode) && scriptSize > 0) munmap(const_cast<char*>(script), scriptSize);
+    _sweepJobs(smash, true);
+    return smash.lastExitStatus;
 }
 
 int main(int argc, char *argv[]) {
-    //set sigaction struct
-
-    struct sigaction action;
-    action.sa_handler = SignalHandlers::alarmHandler;
-    if (sigemptyset(&action.sa_mask) < 0) perror("smash error: sigemptyset");
-    action.sa_flags = SA_RESTART;
-
+    //smash -c <command line> - run a single line and exit with its status, once the jobs it queued were launched.
+    //The fds smash waits for events on are only created if the line waits for something, so a builtin runs without
+    //the syscalls that set them up
+    const bool singleLine = (argc > 2 && !strcmp(argv[1], "-c"));
 
     DEBUG_PRINT("this pid is " << getpid() << endl);
-    if (signal(SIGTSTP, SignalHandlers::ctrlZHandler) == SIG_ERR) {
-        perror("smash error: failed to set ctrl-Z handler");
+    SmallShell& smash = SmallShell::getInstance();
+    shell = &smash;
+
+    //ctrl-C, ctrl-Z, child state changes and alarms are read from a signal fd and handled between other work,
+    //never in signal context
+    try {
+        smash.watchSignals(singleLine);
+    } catch (SmashExceptions::SyscallException& error) {
+        perror(error.what());
+        return 1;
     }
-    if (signal(SIGINT, SignalHandlers::ctrlCHandler) == SIG_ERR) {
-        perror("smash error: failed to set ctrl-C handler");
+
+    if (singleLine) {
+        smash.executeCommand(argv[2]);
+        _sweepJobs(smash, true);
+        return smash.lastExitStatus;
     }
 
-    if(sigaction(SIGALRM , &action, nullptr) == -1) {
-        perror("smash error: failed to set alarm signal handler");
+    //smash [-t] [script] - with a script, run it in batch mode (-t reports its wall times at exit)
+    bool reportTimes = false;
+    int argument = 1;
+    if (argument < argc && !strcmp(argv[argument], "-t")) {
+        reportTimes = true;
+        ++argument;
     }
+    if (argument < argc) return _runScript(smash, argv[argument], reportTimes);
 
-    SmallShell& smash = SmallShell::getInstance();
-    shell = &smash;
+    //only lines typed at the prompt go to the history, unless a history file was set up explicitly
+    smash.history.setRecording(isatty(STDIN_FILENO) || getenv("SMASH_HISTORY"));
+
+    //outside the loop, so that reading a line reuses the buffer of the last one
+    std::string cmd_line;
     while(true) {
         std::cout << smash.getSmashPrompt();
-        std::string cmd_line;
-        std::getline(std::cin, cmd_line);
-
-        try{
-            smash.jobs.removeFinishedJobs();
-        }
-        catch (SmashExceptions::SameFileException& e) {
-            cout << e.what() << endl;
-        }
-        catch (SmashExceptions::SyscallException& error){
-            std::perror(error.what());
-            fflush(stderr);
-        }
-        catch (SmashExceptions::Exception &error) {
-            cerr << error.what() << endl;
-            cerr.flush();
-        }
+        //jobs are reaped, and queued jobs launched, as they change state while smash sits at the prompt
+        if (!smash.readLine(cmd_line, _sweepIdleJobs)) break; //end of input
 
+        _sweepJobs(smash);
+        if (!_recordLine(smash, cmd_line)) continue;
         smash.executeCommand(cmd_line);
     }
-    return 0;
+    _sweepJobs(smash, true);
+    return smash.lastExitStatus;
 }